@@ -1,739 +1,572 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include <stdbool.h>
-
-#include <SDL3/SDL.h>
-#include <SDL3/SDL_main.h>
-
-
-// original CHIP8 display 64x32
-#define CHIP8_WIDTH 64
-#define CHIP8_HEIGHT 32
-
-
-/* default colors: background 0x000000
-                   pixel 0xffffff
-                   */
-
-#define BACKGROUND_COLOR 0x000000
-#define PIXEL_COLOR 0xcdf7f6
-
-
-#define pixel_size 20 // scale for SDL screen
-
-
-//states
-typedef enum{
-    QUIT,
-    RUNNING,
-    PAUSE,
-}emulator_state_t;
-
-typedef struct {
-    uint16_t opcode;
-    uint16_t NNN;   // constants
-    uint8_t NN;
-    uint8_t N;
-    uint8_t X;  //identifiers
-    uint8_t Y;
-}instruction_t;
-
-//chip8 machine
-typedef struct{
-    emulator_state_t state;
-    uint8_t ram[4096];  //byte
-    bool display[2048]; // 64*32 -- chip8 resolution
-    uint16_t stack[12]; //word
-    uint16_t *stack_pointer;
-    uint8_t V_reg[16];  // registers V0 - VF
-    uint16_t I;         // index reg
-    bool keyboard[16];
-    uint8_t timer1;     // video timer
-    uint8_t timer2;     // audio timer
-    uint16_t PC;        //program counter
-    char* rom_name;
-    instruction_t  instruction; //current instr
-}chip8_t;
-
-
-// sdl initialization
-bool init_sdl(void) {
-
-
-
-
-    Uint32 flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO;
-    SDL_Init(flags);
-
-    // Check if initialized
-    if ((SDL_WasInit(flags) & SDL_INIT_VIDEO) == 0) {
-        SDL_Log("Video subsystem does not initialize \n");
-        SDL_Log("SDL_Init returned: 0x%x, SDL_WasInit: 0x%x\n", SDL_WasInit(0), SDL_WasInit(flags));
-    }
-    if ((SDL_WasInit(flags) & SDL_INIT_AUDIO) == 0) {
-        SDL_Log("Audio subsystem does not initialize \n");
-        SDL_Log("SDL_Init returned: 0x%x, SDL_WasInit: 0x%x\n", SDL_WasInit(0), SDL_WasInit(flags));
-    }
-
-
-    return true;
-}
-
-
-// chip8 initialization
-bool init_chip(chip8_t *chip8, char rom_name[]){
-    // load font
-    const uint8_t font[] = {
-            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-            0x20, 0x60, 0x20, 0x20, 0x70, // 1
-            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
-
-    memcpy(&chip8->ram[0x050], font, sizeof(font));
-
-    //load rom
-
-    FILE *rom = fopen(rom_name, "rb");
-    if(!rom) {
-        SDL_Log("ROM file %s not found", rom_name);
-        return false;
-    }
-
-
-    fseek(rom, 0, SEEK_END);
-    const size_t rom_size = ftell(rom);
-    fseek(rom,0,SEEK_SET);
-
-    const size_t max_size = sizeof chip8->ram - 0x200;
-    if(rom_size > max_size){
-            SDL_Log("ROM file %s too big", rom_name);
-            return false;
-    }
-
-    if(fread(&chip8->ram[0x200], rom_size, 1, rom) != 1){
-        SDL_Log("Could not read file into chip memory");
-        return false;
-    }
-
-    fclose(rom);
-
-    // defaults
-    chip8->state = RUNNING;
-    chip8->PC = 0x200;  // chip8 roms load to 0x200
-    chip8->rom_name = rom_name;
-    chip8->stack_pointer = &chip8->stack[0];
-
-    return true;
-}
-
-
-
-/* original keyboard for CHIP8
- * 123C     1234
- * 456D     QWER
- * 789E     ASDF
- * A0BF     ZXCV
-*/
-
-void input_handler(chip8_t *chip8) {
-    SDL_Event event;
-
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_EVENT_QUIT:
-                chip8->state = QUIT;
-                return;
-
-            case SDL_EVENT_KEY_DOWN:
-                switch (event.key.key) {
-                    case SDLK_ESCAPE:
-                        chip8->state = QUIT;
-                        puts("QUIT PROGRAM VIA ESC_KEY");
-                        return;
-
-                    case SDLK_SPACE:
-                        if (chip8->state == RUNNING) {
-                            chip8->state = PAUSE;
-                            puts("PAUSED");
-                        } else chip8->state = RUNNING;
-
-                        break;
-
-
-
-                    case SDLK_1:
-                        chip8->keyboard[0x1] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_2:
-                        chip8->keyboard[0x2] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_3:
-                        chip8->keyboard[0x3] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_4:
-                        chip8->keyboard[0xC] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_Q:
-                        chip8->keyboard[0x4] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_W:
-                        chip8->keyboard[0x5] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_E:
-                        chip8->keyboard[0x6] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_R:
-                        chip8->keyboard[0xD] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_A:
-                        chip8->keyboard[0x7] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_S:
-                        chip8->keyboard[0x8] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_D:
-                        chip8->keyboard[0x9] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_F:
-                        chip8->keyboard[0xE] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_Z:
-                        chip8->keyboard[0xA] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_X:
-                        chip8->keyboard[0x0] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_C:
-                        chip8->keyboard[0xB] = true;
-                        puts("KEY");
-                        break;
-
-                    case SDLK_V:
-                        chip8->keyboard[0xF] = true;
-                        puts("KEY");
-                        break;
-
-                    default:
-                        break;
-                }
-                break;
-
-
-
-            case SDL_EVENT_KEY_UP:
-                switch (event.key.key) {
-
-                    case SDLK_1:
-                        chip8->keyboard[0x1] = false;
-                        break;
-
-                    case SDLK_2:
-                        chip8->keyboard[0x2] = false;
-                        break;
-
-                    case SDLK_3:
-                        chip8->keyboard[0x3] = false;
-                        break;
-
-                    case SDLK_4:
-                        chip8->keyboard[0xC] = false;
-                        break;
-
-                    case SDLK_Q:
-                        chip8->keyboard[0x4] = false;
-                        break;
-
-                    case SDLK_W:
-                        chip8->keyboard[0x5] = false;
-                        break;
-
-                    case SDLK_E:
-                        chip8->keyboard[0x6] = false;
-                        break;
-
-                    case SDLK_R:
-                        chip8->keyboard[0xD] = false;
-                        break;
-
-                    case SDLK_A:
-                        chip8->keyboard[0x7] = false;
-                        break;
-
-                    case SDLK_S:
-                        chip8->keyboard[0x8] = false;
-                        break;
-
-                    case SDLK_D:
-                        chip8->keyboard[0x9] = false;
-                        break;
-
-                    case SDLK_F:
-                        chip8->keyboard[0xE] = false;
-                        break;
-
-                    case SDLK_Z:
-                        chip8->keyboard[0xA] = false;
-                        break;
-
-                    case SDLK_X:
-                        chip8->keyboard[0x0] = false;
-                        break;
-
-                    case SDLK_C:
-                        chip8->keyboard[0xB] = false;
-                        break;
-
-                    case SDLK_V:
-                        chip8->keyboard[0xF] = false;
-                        break;
-
-
-                    default:
-                        break;
-                }
-                break;
-
-
-        }
-
-    }
-
-}
-
-
-void compute_instruction(chip8_t *chip8) {
-    // FETCH
-    chip8->instruction.opcode = (chip8->ram[chip8->PC] << 8) | chip8->ram[chip8->PC + 1];
-    chip8->PC += 2;
-
-    // DECODE
-    uint16_t opcode = chip8->instruction.opcode;
-    chip8->instruction.NNN = opcode & 0x0FFF;
-    chip8->instruction.NN = opcode & 0x00FF;
-    chip8->instruction.N = opcode & 0x000F;
-    chip8->instruction.X = (opcode >> 8) & 0x000F;
-    chip8->instruction.Y = (opcode >> 4) & 0x000F;
-
-    uint8_t *V = chip8->V_reg;
-
-    // EXECUTE
-    switch ((opcode >> 12) & 0x000F) {
-        case 0x0:
-            switch (chip8->instruction.NN) {
-                case 0xE0: // 00E0: CLS - clear screen
-                    memset(chip8->display, 0, sizeof(chip8->display));
-                    break;
-                case 0xEE: // 00EE: RET - return from subroutine
-                    chip8->stack_pointer--;
-                    chip8->PC = *chip8->stack_pointer;
-                    break;
-                default:
-                    SDL_Log("SYS call 0x%03X ignored", chip8->instruction.NNN);
-                    break;
-            }
-            break;
-
-        case 0x1: // 1NNN: JP addr
-            chip8->PC = chip8->instruction.NNN;
-            break;
-
-        case 0x2: // 2NNN: CALL addr
-            *chip8->stack_pointer++ = chip8->PC;
-
-            chip8->PC = chip8->instruction.NNN;
-            break;
-
-        case 0x3: // 3XNN: SE Vx, NN
-            if (V[chip8->instruction.X] == chip8->instruction.NN)
-                chip8->PC += 2;
-            break;
-
-        case 0x4: // 4XNN: SNE Vx, NN
-            if (V[chip8->instruction.X] != chip8->instruction.NN)
-                chip8->PC += 2;
-            break;
-
-        case 0x5: // 5XY0: Skip next if Vx == Vy
-            if (chip8->instruction.N == 0 &&
-                V[chip8->instruction.X] == V[chip8->instruction.Y])
-                chip8->PC += 2;
-            break;
-
-        case 0x6: // 6XNN: LD Vx, NN
-            V[chip8->instruction.X] = chip8->instruction.NN;
-            break;
-
-        case 0x7: // 7XNN: ADD Vx, NN
-            V[chip8->instruction.X] += chip8->instruction.NN;
-            break;
-
-        case 0x8: { // Arithmetic and bitwise ops
-            uint8_t X = chip8->instruction.X;
-            uint8_t Y = chip8->instruction.Y;
-
-            switch (chip8->instruction.N) {
-                case 0x0:
-                    V[X] = V[Y];
-                    break;                          // 8XY0: LD
-                case 0x1:
-                    V[X] |= V[Y];
-                    break;                         // 8XY1: OR
-                case 0x2:
-                    V[X] &= V[Y];
-                    break;                         // 8XY2: AND
-                case 0x3:
-                    V[X] ^= V[Y];
-                    break;                         // 8XY3: XOR
-                case 0x4: {                                            // 8XY4: ADD
-                    uint16_t sum = V[X] + V[Y];
-                    V[0xF] = sum > 0xFF;
-                    V[X] = sum & 0xFF;
-                    break;
-                }
-                case 0x5:                                              // 8XY5: SUB
-                    V[0xF] = V[X] > V[Y];
-                    V[X] -= V[Y];
-                    break;
-                case 0x6:                                              // 8XY6: SHR
-                    V[0xF] = V[X] & 0x1;
-                    V[X] >>= 1;
-                    break;
-                case 0x7:                                              // 8XY7: SUBN
-                    V[0xF] = V[Y] > V[X];
-                    V[X] = V[Y] - V[X];
-                    break;
-                case 0xE:                                              // 8XYE: SHL
-                    V[0xF] = (V[X] & 0x80) >> 7;
-                    V[X] <<= 1;
-                    break;
-                default:
-                    SDL_Log("Unknown 0x8 opcode: 0x%04X", opcode);
-                    break;
-            }
-            break;
-        }
-
-        case 0x9: // 9XY0: Skip next if Vx != Vy
-            if (chip8->instruction.N == 0 &&
-                V[chip8->instruction.X] != V[chip8->instruction.Y])
-                chip8->PC += 2;
-            break;
-
-        case 0xA: // ANNN: LD I, addr
-            chip8->I = chip8->instruction.NNN;
-            break;
-
-        case 0xB: // BNNN: JP V0 + addr
-            chip8->PC = chip8->instruction.NNN + V[0];
-            break;
-
-        case 0xC: // CXNN: RND Vx, byte
-            V[chip8->instruction.X] = (rand() % 256) & chip8->instruction.NN;
-            break;
-
-        case 0xD: { // DXYN: DRW Vx, Vy, N (draw sprite)
-            uint8_t x = V[chip8->instruction.X] % CHIP8_WIDTH;
-            uint8_t y = V[chip8->instruction.Y] % CHIP8_HEIGHT;
-            uint8_t height = opcode & 0x000F;
-
-            V[0xF] = 0; // reset collision flag
-
-            for (int row = 0; row < height; row++) {
-                uint8_t sprite_byte = chip8->ram[chip8->I + row];
-
-                for (int col = 0; col < 8; col++) {
-                    if (sprite_byte & (0x80 >> col)) {
-                        int px = (x + col) % 64;
-                        int py = (y + row) % 32;
-                        if (px >= CHIP8_WIDTH || py >= CHIP8_HEIGHT) continue;
-
-                        int idx = py * CHIP8_WIDTH + px;
-                        if (chip8->display[idx])
-                            V[0xF] = 1; // collision
-
-
-                        chip8->display[idx] ^= 1;
-                    }
-                }
-            }
-            break;
-
-
-        }
-            break;
-
-
-
-        case 0xE: { // Key operations
-            uint8_t X = chip8->instruction.X;
-            switch (chip8->instruction.NN) {
-                case 0x9E: // EX9E: Skip next if key VX pressed
-                    if (chip8->keyboard[V[X]]) chip8->PC += 2;
-                    break;
-                case 0xA1: // EXA1: Skip next if key VX not pressed
-                    if (!chip8->keyboard[V[X]]) chip8->PC += 2;
-                    break;
-                default:
-                    SDL_Log("Unknown 0xE opcode: 0x%04X", opcode);
-                    break;
-            }
-            break;
-        }
-
-
-        case 0xF: {
-            switch (chip8->instruction.NN) {
-                case 0x0A:
-                    //0xF0A: VX = get key
-                    bool key_pressed = false;
-                    for (uint8_t i = 0; i < sizeof chip8->keyboard; i++) {
-                        if (chip8->keyboard[i]) {
-                            V[chip8->instruction.X] = i;
-                            key_pressed = true;
-                            break;
-                        }
-                    }
-
-                    if (!key_pressed){
-                        chip8->PC -= 2;
-                        return; //keep same opcode if not pressed
-                        }
-                    break;
-
-
-                case 0x1E:
-                    // I += VX;
-                    chip8->I += V[chip8->instruction.X];
-                    break;
-
-                case 0x07:
-                    //   VX = delay timer
-                    V[chip8->instruction.X] = chip8->timer1;
-                    break;
-
-                case 0x15:
-                    //  delay timer = VX
-                    chip8->timer1 = V[chip8->instruction.X];
-                    break;
-
-                case 0x18:
-                    //  audio timer = VX
-                    chip8->timer2 = V[chip8->instruction.X];
-                    break;
-
-                case 0x29:
-                    //  set I to sprite location for char in VX
-                    chip8->I = 0x050+ V[chip8->instruction.X] * 5;
-                    break;
-
-
-                case 0x33:                                            // FX33: BCD
-                    chip8->ram[chip8->I] = V[chip8->instruction.X] / 100;
-                    chip8->ram[chip8->I + 1] = (V[chip8->instruction.X] / 10) % 10;
-                    chip8->ram[chip8->I + 2] = V[chip8->instruction.X] % 10;
-                    break;
-
-                case 0x55:                                             // FX55: Store V0..VX
-                    for (int i = 0; i <= chip8->instruction.X; i++)
-                        chip8->ram[chip8->I + i] = V[i];
-                    break;
-
-                case 0x65:                                             // FX65: Load V0..VX
-                    for (int i = 0; i <= chip8->instruction.X; i++)
-                        V[i] = chip8->ram[chip8->I + i];
-                    break;
-
-                default:
-
-                    break;
-
-            }
-            break;
-
-
-            default:
-                SDL_Log("Unknown opcode: 0x%04X at PC=0x%03X", opcode, chip8->PC - 2);
-            break;
-        }
-    }
-}
-
-
-
-
-
-int main(int argc, char *argv[]) {
-
-    if (argc < 2) {
-        fprintf(stderr, "not enough files \n" );
-
-    }
-
-    srand((unsigned) time(NULL));
-
-
-    // declare
-
-    SDL_Window *win = NULL;
-    SDL_Renderer *renderer = NULL;
-
-
-
-
-    //  initialize sdl
-    if (!init_sdl()) exit(EXIT_FAILURE);
-
-
-
-
-
-
-    if (!SDL_CreateWindowAndRenderer("CHIP-8", CHIP8_WIDTH*pixel_size,
-                                     CHIP8_HEIGHT*pixel_size, SDL_WINDOW_OPENGL, &win, &renderer)) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create window and renderer: %s", SDL_GetError());
-
-    }
-
-
-    if (win == NULL) {
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create window: %s\n", SDL_GetError());
-        exit(EXIT_FAILURE);
-
-    }
-
-    if (renderer == NULL) {
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create renderer: %s\n", SDL_GetError());
-        exit(EXIT_FAILURE);
-
-    }
-
-
-    // initialize chip8
-    chip8_t chip8 = {0};
-    if (!init_chip(&chip8, argv[1])) {
-        exit(EXIT_FAILURE);
-    }
-
-
-    SDL_RenderClear(renderer);
-
-    // get rgb background
-    uint8_t bg_r = (BACKGROUND_COLOR >> 16) & 0xFF;
-    uint8_t bg_g = (BACKGROUND_COLOR >> 8) & 0xFF;
-    uint8_t bg_b = BACKGROUND_COLOR & 0xFF;
-
-
-    //get rgb pixels
-    uint8_t pixel_r = (PIXEL_COLOR >> 16) & 0xFF;
-    uint8_t pixel_g = (PIXEL_COLOR >> 8) & 0xFF;
-    uint8_t pixel_b = PIXEL_COLOR & 0xFF;
-
-
-    // main loop
-    while (chip8.state != QUIT) {
-
-        uint64_t now = SDL_GetTicks();
-        uint64_t last_tick = 0;
-
-        if (now - last_tick >= 16) {      // ~60 Hz (1000/60 = 16.666)
-            if (chip8.timer1 > 0) chip8.timer1--;
-            if (chip8.timer2 > 0) chip8.timer2--;
-            last_tick = now;
-        }
-
-
-
-
-        input_handler(&chip8);
-
-        if (chip8.state == PAUSE) continue;
-
-
-      // compute instruction
-        for(int i=0; i<8; i++) {
-            compute_instruction(&chip8);
-        }
-
-        SDL_SetRenderDrawColor(renderer, bg_r, bg_g, bg_b, 255);
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, pixel_r, pixel_g, pixel_b, 255);
-
-
-        for (int y = 0; y < CHIP8_HEIGHT; y++) {
-            for (int x = 0; x < CHIP8_WIDTH; x++) {
-                if (chip8.display[y * CHIP8_WIDTH + x]) {
-                    SDL_FRect rect = { x * pixel_size, y * pixel_size, pixel_size, pixel_size };
-                    SDL_RenderFillRect(renderer, &rect);
-
-
-
-
-                }
-
-            }
-        }
-
-        SDL_RenderPresent(renderer);
-
-
-        //60Hz
-        SDL_Delay(1000/60);
-
-
-
-    }
-
-    // final clean
-    SDL_DestroyWindow(win);
-    SDL_DestroyRenderer(renderer);
-    SDL_Quit();
-    exit(EXIT_SUCCESS);
-
-
-
-    return 0;
-}
-
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_main.h>
+
+#include "chip8_core.h"
+#include "chip8_cache.h"
+#include "chip8_block.h"
+#include "chip8_video.h"
+#include "chip8_sched.h"
+#include "chip8_thread.h"
+#include "chip8_batch.h"
+#include "chip8_state.h"
+#include "chip8_replay.h"
+#include "chip8_prof.h"
+#include "chip8_trace.h"
+#include "chip8_debug.h"
+#include "chip8_variant.h"
+#include "chip8_keymap.h"
+#include "chip8_audio.h"
+
+
+
+#define pixel_size 20 // scale for SDL screen
+
+
+// sdl initialization
+bool init_sdl(void) {
+
+
+
+
+    Uint32 flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO;
+    SDL_Init(flags);
+
+    // Check if initialized
+    if ((SDL_WasInit(flags) & SDL_INIT_VIDEO) == 0) {
+        SDL_Log("Video subsystem does not initialize \n");
+        SDL_Log("SDL_Init returned: 0x%x, SDL_WasInit: 0x%x\n", SDL_WasInit(0), SDL_WasInit(flags));
+    }
+    if ((SDL_WasInit(flags) & SDL_INIT_AUDIO) == 0) {
+        SDL_Log("Audio subsystem does not initialize \n");
+        SDL_Log("SDL_Init returned: 0x%x, SDL_WasInit: 0x%x\n", SDL_WasInit(0), SDL_WasInit(flags));
+    }
+
+
+    return true;
+}
+
+
+
+// CHIP8 key down/up: update the keypad and queue it for the emulation thread
+static void set_key(input_t *input, int key, bool down, uint64_t time) {
+    uint16_t keys = down ? input->keys | (1 << key) : input->keys & ~(1 << key);
+    if (keys == input->keys) return;
+
+    input->keys = keys;
+    key_queue_push(input, time, keys);  // when full the next change carries this one
+}
+
+
+void input_handler(input_t *input, const keymap_t *keymap) {
+    SDL_Event event;
+
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_EVENT_QUIT:
+                SDL_SetAtomicInt(&input->state, QUIT);
+                return;
+
+            case SDL_EVENT_WINDOW_EXPOSED:
+            case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+                input->redraw = true;   // window contents lost or resized, redraw everything
+                break;
+
+            case SDL_EVENT_KEY_DOWN:
+            case SDL_EVENT_KEY_UP: {
+                bool down = event.type == SDL_EVENT_KEY_DOWN;
+                int key = keymap_lookup(keymap, event.key.scancode);
+
+                if (key != KEYMAP_NONE) {
+                    set_key(input, key, down, event.key.timestamp);
+                    break;
+                }
+                if (event.key.repeat) break;
+
+                switch (event.key.key) {
+                    case SDLK_ESCAPE:
+                        if (down) {
+                            SDL_SetAtomicInt(&input->state, QUIT);
+                            return;
+                        }
+                        break;
+
+                    case SDLK_SPACE:
+                        if (down)
+                            SDL_SetAtomicInt(&input->state, SDL_GetAtomicInt(&input->state) == RUNNING ? PAUSE : RUNNING);
+                        break;
+
+                    case SDLK_F5:
+                        if (down) SDL_SetAtomicInt(&input->command, CMD_SAVE_STATE);
+                        break;
+
+                    case SDLK_F9:
+                        if (down) SDL_SetAtomicInt(&input->command, CMD_LOAD_STATE);
+                        break;
+
+                    case SDLK_F8:
+                        if (down) SDL_SetAtomicInt(&input->command, CMD_CONTINUE);
+                        break;
+
+                    case SDLK_F10:
+                        if (down) SDL_SetAtomicInt(&input->command, CMD_STEP_OVER);
+                        break;
+
+                    case SDLK_F11:
+                        if (down) SDL_SetAtomicInt(&input->command, CMD_STEP);
+                        break;
+
+                    case SDLK_BACKSPACE:
+                        SDL_SetAtomicInt(&input->rewind, down);
+                        break;
+
+                    default:
+                        break;
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+
+// headless batch run: no window, no frame delay
+static int run_headless(chip8_t *chip8, uint64_t hz, uint64_t cycles, const char *save_state,
+                        const chip8_replay_t *replay) {
+    chip8_sched_t sched;
+
+    chip8_sched_init(&sched, hz);
+
+    uint64_t mark = chip8->prof ? chip8_prof_now() : 0;
+    if (replay) chip8_replay_run(chip8, replay, &sched, cycles);
+    else chip8_sched_run(chip8, &sched, cycles);
+    chip8_prof_mark(chip8->prof, PROF_EMULATE, mark);
+
+    if (chip8_debug_stopped(chip8)) chip8_debug_print_state(chip8, stdout);
+
+    if (save_state && !chip8_state_save_file(chip8, save_state))
+        return EXIT_FAILURE;
+
+    chip8_dump(chip8, stdout);
+    return EXIT_SUCCESS;
+}
+
+
+// --debug: headless under a command prompt on stdin, starting stopped at
+// the first instruction. --cycles, when given, still caps the run
+static int run_debugger(chip8_t *chip8, uint64_t hz, uint64_t cycles) {
+    chip8_sched_t sched;
+    char line[128];
+
+    chip8_sched_init(&sched, hz);
+    chip8->debug->stop = CHIP8_STOP_STEP;
+
+    for (;;) {
+        chip8_debug_print_state(chip8, stdout);
+        if (CHIP8_FAULTED(chip8) || chip8->state == QUIT) break;
+
+        chip8_debug_action_t action = CHIP8_DEBUG_STAY;
+        while (action == CHIP8_DEBUG_STAY) {
+            fputs("> ", stdout);
+            fflush(stdout);
+            action = fgets(line, sizeof line, stdin) ? chip8_debug_command(chip8, line, stdout) : CHIP8_DEBUG_QUIT;
+        }
+        if (action == CHIP8_DEBUG_QUIT) break;
+
+        // a second of instructions at a time until something stops the machine
+        while (!chip8_debug_stopped(chip8) && !CHIP8_FAULTED(chip8) && chip8->state != QUIT) {
+            if (cycles && sched.cycles >= cycles) {
+                printf("--cycles %llu reached\n", (unsigned long long)cycles);
+                chip8_dump(chip8, stdout);
+                return EXIT_SUCCESS;
+            }
+            chip8_sched_run(chip8, &sched, cycles ? SDL_min(cycles - sched.cycles, sched.hz) : sched.hz);
+        }
+    }
+
+    chip8_dump(chip8, stdout);
+    return EXIT_SUCCESS;
+}
+
+
+// --profile report to stderr, the --trace and --heatmap files
+static void profile_finish(chip8_t *chip8, const char *trace, const char *heatmap) {
+    chip8_prof_report(chip8->prof, chip8->ram, stderr);
+    if (trace && chip8_prof_write_trace(chip8->prof, trace))
+        fprintf(stderr, "trace written to %s\n", trace);
+    if (heatmap && chip8_prof_write_heatmap(chip8->prof, heatmap))
+        fprintf(stderr, "heatmap written to %s\n", heatmap);
+    chip8_prof_free(chip8->prof);
+}
+
+
+// many headless runs in parallel, one result line each
+static int run_batch(const char *list, uint64_t hz, uint64_t cycles, int seeds, int threads, bool lanes,
+                     chip8_variant_t variant) {
+    // the lockstep core only knows the default instruction set
+    if (lanes && variant != CHIP8_VARIANT_DEFAULT) {
+        SDL_Log("--lanes runs the default variant only, running %s jobs one by one", chip8_variant_names[variant]);
+        lanes = false;
+    }
+#ifdef CHIP8_CHECKED
+    // nor traps faults, it masks every access
+    if (lanes) {
+        SDL_Log("--lanes is unchecked, running jobs one by one in this checked build");
+        lanes = false;
+    }
+#endif
+
+    batch_t batch = { .cycles = cycles, .hz = hz, .threads = threads, .lanes = lanes, .variant = variant };
+    chip8_rom_cache_t roms;
+
+    chip8_rom_cache_init(&roms);
+    batch.jobs = batch_load_list(list, seeds, &roms, &batch.count);
+    if (!batch.jobs) return EXIT_FAILURE;
+
+    batch_run(&batch);
+    batch_print(&batch, stdout);
+    batch_free(batch.jobs, batch.count);
+    chip8_rom_cache_free(&roms);
+    return EXIT_SUCCESS;
+}
+
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--core interp|cached|block] [--hz N] [--seed N] [--load-state F | --record F]\n"
+                    "                   [--variant default|cosmac|schip|xochip] [--keymap F]\n"
+                    "                   [--profile] [--trace F] [--heatmap F] [--no-idle-skip] [--exec-trace F]\n"
+                    "                   [--fullscreen] [--soft-scale] [--phosphor PCT] [--scanlines PCT]\n"
+                    "       %s [--headless --cycles N [--save-state F]] rom\n"
+                    "       %s --replay F [--cycles N] rom\n"
+                    "       %s --batch list --cycles N [--seeds N] [--threads N] [--lanes] [--hz N] [--variant V]\n"
+                    "       %s --exec-diff A B\n"
+                    "       debugging: [--break ADDR]... [--watch ADDR[:LEN]]... [--debug (headless prompt)]\n",
+            prog, prog, prog, prog, prog);
+}
+
+
+int main(int argc, char *argv[]) {
+
+    bool headless = false;
+    uint64_t cycles = 0;
+    uint64_t hz = CHIP8_DEFAULT_HZ;
+    uint32_t seed = (uint32_t) time(NULL);
+    const char *batch_list = NULL;
+    int seeds = 1;
+    int threads = 0;
+    bool lanes = false;
+    const char *load_state = NULL;
+    const char *save_state = NULL;
+    const char *record = NULL;
+    const char *replay_path = NULL;
+    bool profile = false;
+    const char *trace = NULL;
+    const char *heatmap = NULL;
+    const char *exec_trace = NULL;
+    bool debug_prompt = false;
+    chip8_debug_t debug;
+    chip8_debug_init(&debug);
+    bool skip_idle = true;
+    const char *keymap_path = NULL;
+    video_filter_t filter = {0};
+    bool fullscreen = false;
+    chip8_variant_t variant = CHIP8_VARIANT_DEFAULT;
+    char *rom_name = NULL;
+    const char *core = "cached";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_list = argv[++i];
+        } else if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+            seeds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--load-state") == 0 && i + 1 < argc) {
+            load_state = argv[++i];
+        } else if (strcmp(argv[i], "--save-state") == 0 && i + 1 < argc) {
+            save_state = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace = argv[++i];
+            profile = true;
+        } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmap = argv[++i];
+            profile = true;
+        } else if (strcmp(argv[i], "--exec-trace") == 0 && i + 1 < argc) {
+            exec_trace = argv[++i];
+        } else if (strcmp(argv[i], "--exec-diff") == 0 && i + 2 < argc) {
+            int diff = chip8_trace_diff(argv[i + 1], argv[i + 2], stdout);
+            return diff == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if (strcmp(argv[i], "--debug") == 0) {
+            debug_prompt = true;
+        } else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc) {
+            chip8_debug_break(&debug, strtoul(argv[++i], NULL, 16), true);
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            char *len;
+            uint16_t addr = strtoul(argv[++i], &len, 16);
+            chip8_debug_watch(&debug, addr, *len == ':' ? strtoul(len + 1, NULL, 0) : 1, true);
+        } else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+            if (!chip8_variant_parse(argv[++i], &variant)) {
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--keymap") == 0 && i + 1 < argc) {
+            keymap_path = argv[++i];
+        } else if (strcmp(argv[i], "--fullscreen") == 0) {
+            fullscreen = true;
+        } else if (strcmp(argv[i], "--soft-scale") == 0) {
+            filter.soft = true;
+        } else if (strcmp(argv[i], "--phosphor") == 0 && i + 1 < argc) {
+            filter.phosphor = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scanlines") == 0 && i + 1 < argc) {
+            filter.scanlines = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-idle-skip") == 0) {
+            skip_idle = false;
+        } else if (strcmp(argv[i], "--lanes") == 0) {
+            lanes = true;
+        } else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc) {
+            hz = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc) {
+            core = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        } else {
+            rom_name = argv[i];
+        }
+    }
+
+    if (batch_list) {
+        if (cycles == 0) {
+            fprintf(stderr, "--batch needs --cycles N \n");
+            exit(EXIT_FAILURE);
+        }
+        return run_batch(batch_list, hz, cycles, seeds, threads, lanes, variant);
+    }
+
+    if (rom_name == NULL) {
+        fprintf(stderr, "not enough files \n" );
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (debug_prompt && replay_path) {
+        fprintf(stderr, "--debug reads commands instead of replaying input, drop --replay \n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (record && load_state) {
+        fprintf(stderr, "--record starts from a fresh machine, drop --load-state \n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a replay brings its own seed and clock and runs headless
+    chip8_replay_t replay;
+    if (replay_path) {
+        if (!chip8_replay_load(&replay, replay_path)) exit(EXIT_FAILURE);
+        seed = replay.seed;
+        hz = replay.hz;
+        variant = replay.variant;
+        headless = true;
+        if (cycles == 0) cycles = replay.cycles;
+    }
+
+    // initialize chip8
+    chip8_t chip8 = {0};
+    if (!init_chip(&chip8, rom_name)) {
+        exit(EXIT_FAILURE);
+    }
+    chip8_seed(&chip8, seed);
+    chip8_set_variant(&chip8, variant);
+    chip8.skip_idle = skip_idle;
+
+    if (load_state && !chip8_state_load_file(&chip8, load_state))
+        exit(EXIT_FAILURE);
+
+    chip8_prof_t prof;
+    if (profile) {
+        if (!chip8_prof_init(&prof, trace != NULL)) exit(EXIT_FAILURE);
+        chip8.prof = &prof;
+    }
+
+    // decode cache or block translator unless the reference interpreter was asked for
+    chip8_cache_t *cache = NULL;
+    chip8_blocks_t *blocks = NULL;
+    if (strcmp(core, "cached") == 0) {
+        cache = malloc(sizeof *cache);
+        if (!cache) exit(EXIT_FAILURE);
+        chip8_cache_attach(&chip8, cache);
+    } else if (strcmp(core, "block") == 0) {
+        blocks = malloc(sizeof *blocks);
+        if (!blocks) exit(EXIT_FAILURE);
+        chip8_blocks_attach(&chip8, blocks);
+    } else if (strcmp(core, "interp") != 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (exec_trace) {
+        chip8.trace = chip8_trace_open(exec_trace, variant);
+        if (!chip8.trace) exit(EXIT_FAILURE);
+    }
+
+    // always there in the window (F8/F10/F11), headless only when asked for
+    if (!headless || debug_prompt || chip8_debug_armed(&debug))
+        chip8.debug = &debug;
+
+    if (debug_prompt) {
+        int status = run_debugger(&chip8, hz, cycles);
+        if (chip8.trace) chip8_trace_close(chip8.trace);
+        return status;
+    }
+
+    if (headless) {
+        if (cycles == 0) {
+            fprintf(stderr, "--headless needs --cycles N \n");
+            exit(EXIT_FAILURE);
+        }
+        int status = run_headless(&chip8, hz, cycles, save_state, replay_path ? &replay : NULL);
+        if (chip8.prof) profile_finish(&chip8, trace, heatmap);
+        if (chip8.trace) chip8_trace_close(chip8.trace);
+        return status;
+    }
+
+
+    // declare
+
+    SDL_Window *win = NULL;
+    SDL_Renderer *renderer = NULL;
+
+
+
+
+    //  initialize sdl
+    if (!init_sdl()) exit(EXIT_FAILURE);
+
+
+
+
+
+
+    if (!SDL_CreateWindowAndRenderer("CHIP-8", CHIP8_WIDTH*pixel_size,
+                                     CHIP8_HEIGHT*pixel_size,
+                                     SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | (fullscreen ? SDL_WINDOW_FULLSCREEN : 0),
+                                     &win, &renderer)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not create window and renderer: %s", SDL_GetError());
+
+    }
+
+
+    if (win == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create window: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+
+    }
+
+    if (renderer == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create renderer: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+
+    }
+
+
+    video_t video;
+    if (!video_init(&video, renderer, &filter)) exit(EXIT_FAILURE);
+
+    keymap_t keymap;
+    keymap_default(&keymap);
+    if (keymap_path && !keymap_load(&keymap, keymap_path)) exit(EXIT_FAILURE);
+
+    // fed by the emulation thread, a missing device only means no sound
+    audio_t audio;
+    bool sound = audio_init(&audio);
+
+
+    // emulation runs on its own thread, this one handles input and presents
+    SDL_SetRenderVSync(renderer, 1);
+
+    input_t input = { .redraw = true };
+    SDL_SetAtomicInt(&input.state, chip8.state);
+
+    frame_buffer_t *frames = malloc(sizeof *frames);
+    if (!frames) exit(EXIT_FAILURE);
+    frame_buffer_init(frames);
+
+    // F5/F9 save and load the --load-state / --save-state file
+    const char *state_path = load_state ? load_state : save_state ? save_state : "chip8.state";
+
+    chip8_replay_t recording;
+    chip8_replay_init(&recording, seed, hz);
+    recording.variant = variant;
+
+    emu_thread_t emu = { .chip8 = &chip8, .hz = hz, .input = &input, .frames = frames,
+                         .state_path = state_path, .record = record ? &recording : NULL,
+                         .audio = sound ? &audio : NULL };
+    if (!emu_thread_start(&emu)) exit(EXIT_FAILURE);
+
+    // main loop
+    const chip8_screen_t *screen = &frames->screens[frames->read];
+
+    while (SDL_GetAtomicInt(&input.state) != QUIT) {
+
+        uint64_t mark = chip8.prof ? chip8_prof_now() : 0;
+        input_handler(&input, &keymap);
+        mark = chip8_prof_mark(chip8.prof, PROF_INPUT, mark);
+
+        const chip8_screen_t *latest = frame_buffer_take(frames);
+        if (latest) screen = latest;
+
+        if (latest || input.redraw || video.fading) {
+            video_render(&video, screen, input.redraw);    // vsync paces this
+            input.redraw = false;
+            chip8_prof_mark(chip8.prof, PROF_RENDER, mark);
+        } else {
+            SDL_WaitEventTimeout(NULL, 1);     // woken early by input
+            chip8_prof_mark(chip8.prof, PROF_IDLE, mark);
+        }
+    }
+
+    emu_thread_join(&emu);
+    free(frames);
+
+    if (chip8.trace) chip8_trace_close(chip8.trace);
+
+    if (chip8.prof) profile_finish(&chip8, trace, heatmap);
+
+    if (record && chip8_replay_save(&recording, record))
+        SDL_Log("Input recorded to %s", record);
+    chip8_replay_free(&recording);
+
+    // final clean
+    audio_destroy(&audio);
+    video_destroy(&video);
+    SDL_DestroyWindow(win);
+    SDL_DestroyRenderer(renderer);
+    SDL_Quit();
+    free(cache);
+    free(blocks);
+    exit(EXIT_SUCCESS);
+
+
+
+    return 0;
+}
+
+
@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include "chip8_audio.h"
+
+
+bool audio_init(audio_t *audio) {
+    memset(audio, 0, sizeof *audio);
+
+    // small device buffer, the stream depth below sets the latency
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, AUDIO_DEVICE_FRAMES);
+
+    SDL_AudioSpec spec = { SDL_AUDIO_S16, 1, AUDIO_RATE };
+    audio->stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
+    if (audio->stream == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not open audio device: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_ResumeAudioStreamDevice(audio->stream);
+    return true;
+}
+
+
+// count samples of one frame into audio->samples
+static void render_frame(audio_t *audio, int count, bool beep) {
+    if (!beep) {
+        memset(audio->samples, 0, count * sizeof audio->samples[0]);
+        return;
+    }
+
+    const uint32_t step = (uint32_t)(((uint64_t)AUDIO_TONE_HZ << 32) / AUDIO_RATE);
+    for (int i = 0; i < count; i++, audio->phase += step)
+        audio->samples[i] = (audio->phase >> 31) ? -AUDIO_VOLUME : AUDIO_VOLUME;
+}
+
+
+void audio_frames(audio_t *audio, uint64_t frames, uint64_t beeps) {
+    const int max_queued = AUDIO_RATE * AUDIO_MAX_QUEUED_MS / 1000 * (int)sizeof(int16_t);
+
+    while (frames--) {
+        audio->sample_acc += AUDIO_RATE;
+        int count = audio->sample_acc / 60;
+        audio->sample_acc %= 60;
+
+        // a frame that doesn't fit under the latency cap is dropped whole,
+        // before it moves the phase, so the next one carries on without a jump
+        int bytes = count * sizeof(int16_t);
+        if (bytes > max_queued - SDL_GetAudioStreamQueued(audio->stream)) continue;
+
+        render_frame(audio, count, frames < 64 && (beeps >> frames & 1));
+        SDL_PutAudioStreamData(audio->stream, audio->samples, bytes);
+    }
+}
+
+
+void audio_destroy(audio_t *audio) {
+    if (audio->stream) SDL_DestroyAudioStream(audio->stream);
+    audio->stream = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef CHIP8_AUDIO_H
+#define CHIP8_AUDIO_H
+
+#include <SDL3/SDL.h>
+
+
+/* beeper
+ * a square wave while the sound timer runs. samples are generated per
+ * emulated 60Hz frame on the emulation thread and pushed into an
+ * SDL_AudioStream; the stream is kept at most AUDIO_MAX_QUEUED_MS deep, so
+ * when the host falls behind or catches up the extra frames are dropped
+ * whole instead of piling up as latency. a dropped frame leaves the phase
+ * where it was, and frames carry the fractional sample, so the tone stays
+ * clean at any --hz.
+ */
+
+#define AUDIO_RATE 48000
+#define AUDIO_TONE_HZ 440
+#define AUDIO_VOLUME 3000           // of 32767
+#define AUDIO_MAX_QUEUED_MS 25     // a frame (16.7ms) plus a device period, plus slack
+#define AUDIO_DEVICE_FRAMES "256"   // device buffer, ~5ms at AUDIO_RATE
+
+typedef struct {
+    SDL_AudioStream *stream;
+    uint32_t phase;         // tone phase, 2^32 per period
+    uint32_t sample_acc;    // AUDIO_RATE remainder of the 60Hz frames so far
+    int16_t samples[AUDIO_RATE / 60 + 1];
+}audio_t;
+
+
+// false if no playback device could be opened; run silent then
+bool audio_init(audio_t *audio);
+
+// frames emulated 60Hz frames, oldest first; bit frames - 1 - i of beeps is
+// whether frame i beeps (chip8_sched_t.beeps), older than 64 frames are silent
+void audio_frames(audio_t *audio, uint64_t frames, uint64_t beeps);
+void audio_destroy(audio_t *audio);
+
+#endif // CHIP8_AUDIO_H
@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_batch.h"
+#include "chip8_cache.h"
+#include "chip8_sched.h"
+#include "chip8_lanes.h"
+#include "chip8_variant.h"
+
+
+typedef struct {
+    SDL_AtomicInt next;     // next unclaimed group of this range
+    int end;
+}batch_range_t;
+
+// unit of work: one job, or up to CHIP8_LANES jobs of the same rom in lockstep
+typedef struct {
+    int first;
+    int count;
+}batch_group_t;
+
+typedef struct {
+    batch_t *batch;
+    batch_group_t *groups;
+    batch_range_t *ranges;
+    int index;
+    int workers;
+}batch_worker_t;
+
+
+static void run_job(const batch_t *batch, batch_job_t *job, chip8_cache_t *cache) {
+    chip8_t chip8 = {0};
+
+    job->ok = job->rom && chip8_load(&chip8, job->rom->data, job->rom->size);
+    if (!job->ok) return;
+    chip8.rom_name = job->rom_name;
+
+    chip8_seed(&chip8, job->seed);
+    chip8_set_variant(&chip8, batch->variant);
+    chip8_cache_attach(&chip8, cache);
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, batch->hz);
+    chip8_sched_run(&chip8, &sched, batch->cycles);
+
+    job->hash = chip8_hash(&chip8);
+    job->cycles = sched.cycles;
+    job->frames = sched.frames;
+    job->fault = chip8.fault;
+    job->fault_pc = chip8.PC;
+}
+
+
+static void run_lanes_group(const batch_t *batch, batch_job_t *jobs, int count, chip8_lanes_t *lanes) {
+    chip8_t chip8 = {0};
+
+    bool ok = jobs[0].rom && chip8_load(&chip8, jobs[0].rom->data, jobs[0].rom->size);
+    for (int i = 0; i < count; i++)
+        jobs[i].ok = ok;
+    if (!ok) return;
+
+    chip8_lanes_init(lanes, &chip8, count);
+    for (int i = 0; i < count; i++)
+        chip8_lanes_seed(lanes, i, jobs[i].seed);
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, batch->hz);
+    chip8_lanes_run(lanes, &sched, batch->cycles);
+
+    for (int i = 0; i < count; i++) {
+        chip8_lanes_get(lanes, i, &chip8);
+        jobs[i].hash = chip8_hash(&chip8);
+        jobs[i].cycles = sched.cycles;
+        jobs[i].frames = sched.frames;
+    }
+}
+
+
+// claim the next group of a range, -1 once it is used up
+static int claim(batch_range_t *range) {
+    if (SDL_GetAtomicInt(&range->next) >= range->end) return -1;
+
+    int job = SDL_AddAtomicInt(&range->next, 1);
+    return job < range->end ? job : -1;
+}
+
+
+static int batch_worker(void *data) {
+    batch_worker_t *worker = data;
+    batch_t *batch = worker->batch;
+    chip8_cache_t *cache = malloc(sizeof *cache);
+    chip8_lanes_t *lanes = batch->lanes ? malloc(sizeof *lanes) : NULL;
+    if (!cache || (batch->lanes && !lanes)) {
+        free(cache);
+        free(lanes);
+        return -1;
+    }
+
+    // own range first, then steal from the others in turn
+    for (int i = 0; i < worker->workers; i++) {
+        batch_range_t *range = &worker->ranges[(worker->index + i) % worker->workers];
+        int g;
+
+        while ((g = claim(range)) >= 0) {
+            batch_group_t *group = &worker->groups[g];
+
+            if (lanes)
+                run_lanes_group(batch, &batch->jobs[group->first], group->count, lanes);
+            else
+                run_job(batch, &batch->jobs[group->first], cache);
+        }
+    }
+
+    free(lanes);
+    free(cache);
+    return 0;
+}
+
+
+// one group per job, or runs of the same rom packed into lanes
+static batch_group_t *make_groups(const batch_t *batch, int *count) {
+    batch_group_t *groups = malloc(batch->count * sizeof *groups);
+    int n = 0;
+    if (!groups) return NULL;
+
+    for (int i = 0; i < batch->count; i++) {
+        batch_group_t *last = n ? &groups[n - 1] : NULL;
+
+        if (batch->lanes && last && last->count < CHIP8_LANES
+            && batch->jobs[last->first].rom == batch->jobs[i].rom)
+            last->count++;
+        else
+            groups[n++] = (batch_group_t){ i, 1 };
+    }
+
+    *count = n;
+    return groups;
+}
+
+
+void batch_run(batch_t *batch) {
+    int count;
+    batch_group_t *groups = make_groups(batch, &count);
+    if (!groups) return;
+
+    int workers = batch->threads > 0 ? batch->threads : SDL_GetNumLogicalCPUCores();
+    if (workers > count) workers = count;
+
+    batch_range_t *ranges = NULL;
+    batch_worker_t *pool = NULL;
+    SDL_Thread **threads = NULL;
+    if (workers < 1) goto done;
+
+    ranges = calloc(workers, sizeof *ranges);
+    pool = calloc(workers, sizeof *pool);
+    threads = calloc(workers, sizeof *threads);
+    if (!ranges || !pool || !threads) goto done;
+
+    for (int i = 0; i < workers; i++) {
+        SDL_SetAtomicInt(&ranges[i].next, (int)((int64_t)count * i / workers));
+        ranges[i].end = (int)((int64_t)count * (i + 1) / workers);
+        pool[i] = (batch_worker_t){ batch, groups, ranges, i, workers };
+    }
+
+    for (int i = 0; i < workers; i++) {
+        threads[i] = SDL_CreateThread(batch_worker, "chip8 batch", &pool[i]);
+        if (threads[i] == NULL)
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create batch thread: %s\n", SDL_GetError());
+    }
+
+    // a failed thread's range is stolen by the others; if none started, run here
+    bool any = false;
+    for (int i = 0; i < workers; i++) {
+        if (threads[i]) {
+            SDL_WaitThread(threads[i], NULL);
+            any = true;
+        }
+    }
+    if (!any) batch_worker(&pool[0]);
+
+done:
+    free(threads);
+    free(pool);
+    free(ranges);
+    free(groups);
+}
+
+
+typedef struct {
+    batch_job_t *jobs;
+    int count;
+    int cap;
+    chip8_rom_cache_t *roms;
+}batch_list_t;
+
+
+// jobs for one rom, one per seed (seed < 0: 0..seeds-1)
+static void add_rom(batch_list_t *list, const char *rom, int64_t seed, int seeds) {
+    const chip8_rom_t *image = chip8_rom_get(list->roms, rom);
+    int repeat = seed >= 0 ? 1 : seeds;
+
+    for (int i = 0; i < repeat; i++) {
+        if (list->count == list->cap) {
+            int cap = list->cap ? list->cap * 2 : 64;
+            batch_job_t *grown = realloc(list->jobs, cap * sizeof *grown);
+            if (!grown) return;
+            list->jobs = grown;
+            list->cap = cap;
+        }
+
+        list->jobs[list->count++] = (batch_job_t){
+            .rom_name = strdup(rom), .rom = image, .seed = seed >= 0 ? (uint32_t)seed : (uint32_t)i };
+    }
+}
+
+
+// every *.ch8 in dir, in name order; false if dir is not a directory
+static bool add_dir(batch_list_t *list, const char *dir, int64_t seed, int seeds) {
+    SDL_PathInfo info;
+    if (!SDL_GetPathInfo(dir, &info) || info.type != SDL_PATHTYPE_DIRECTORY) return false;
+
+    int n = 0;
+    char **names = SDL_GlobDirectory(dir, "*.ch8", SDL_GLOB_CASEINSENSITIVE, &n);
+    if (!names) {
+        CHIP8_LOG("Could not list %s: %s", dir, SDL_GetError());
+        return true;
+    }
+
+    char path[2048];
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof path, "%s/%s", dir, names[i]);
+        add_rom(list, path, seed, seeds);
+    }
+
+    SDL_free(names);
+    return true;
+}
+
+
+batch_job_t *batch_load_list(const char *path, int seeds, chip8_rom_cache_t *roms, int *count) {
+    batch_list_t list = { .roms = roms };
+
+    if (seeds < 1) seeds = 1;
+
+    if (add_dir(&list, path, -1, seeds)) {
+        *count = list.count;
+        return list.jobs;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        CHIP8_LOG("ROM list %s not found", path);
+        return NULL;
+    }
+
+    char line[1024];
+
+    while (fgets(line, sizeof line, file)) {
+        char rom[1024];
+        unsigned seed;
+        int fields = sscanf(line, "%1023s %u", rom, &seed);
+        if (fields < 1 || rom[0] == '#') continue;
+
+        int64_t fixed = fields == 2 ? (int64_t)seed : -1;
+        if (!add_dir(&list, rom, fixed, seeds))
+            add_rom(&list, rom, fixed, seeds);
+    }
+
+    fclose(file);
+    *count = list.count;
+    return list.jobs;
+}
+
+
+void batch_print(const batch_t *batch, FILE *out) {
+    for (int i = 0; i < batch->count; i++) {
+        const batch_job_t *job = &batch->jobs[i];
+
+        if (job->ok) {
+            fprintf(out, "%s %u %016llx %llu %llu", job->rom_name, job->seed,
+                    (unsigned long long)job->hash, (unsigned long long)job->cycles,
+                    (unsigned long long)job->frames);
+            if (job->fault != CHIP8_FAULT_NONE)
+                fprintf(out, " fault %s 0x%03X", chip8_fault_names[job->fault], job->fault_pc);
+            fputc('\n', out);
+        } else
+            fprintf(out, "%s %u failed\n", job->rom_name, job->seed);
+    }
+}
+
+
+void batch_free(batch_job_t *jobs, int count) {
+    for (int i = 0; i < count; i++)
+        free(jobs[i].rom_name);
+    free(jobs);
+}
@@ -0,0 +1,57 @@
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <SDL3/SDL.h>
+
+#include "chip8_core.h"
+#include "chip8_rom.h"
+
+
+/* batch runner
+ * runs many headless machines (rom x seed) on a pool of worker threads.
+ * jobs are split into one contiguous range per worker; a worker that runs
+ * out steals the next job from the other ranges, so slow roms don't leave
+ * cores idle. with lanes set, consecutive jobs of the same rom are packed
+ * into one chip8_lanes_t and stepped together. roms come from a shared
+ * chip8_rom_cache_t filled while the list is read, so each file is read
+ * once however many jobs use it
+ */
+
+typedef struct {
+    char *rom_name;
+    const chip8_rom_t *rom;     // shared image, NULL if it failed to load
+    uint32_t seed;
+
+    // results
+    bool ok;
+    uint64_t hash;      // chip8_hash of the final state
+    uint64_t cycles;
+    uint64_t frames;
+    chip8_fault_t fault;    // checked builds, the run stopped here
+    uint16_t fault_pc;
+}batch_job_t;
+
+typedef struct {
+    batch_job_t *jobs;
+    int count;
+    uint64_t cycles;    // instructions per run
+    uint64_t hz;        // only sets the timer rate relative to cycles
+    int threads;        // 0 = one per logical core
+    bool lanes;         // run same-rom jobs together on the lockstep core (default variant only)
+    chip8_variant_t variant;
+}batch_t;
+
+
+// run every job, fills in the results
+void batch_run(batch_t *batch);
+
+// read "rom [seed]" lines, each rom repeated for seeds 0..seeds-1 when no seed is given.
+// a directory, as the list or as a line, stands for every *.ch8 file in it
+batch_job_t *batch_load_list(const char *path, int seeds, chip8_rom_cache_t *roms, int *count);
+
+// one result line per job, faulted runs get "fault <kind> <pc>" appended
+void batch_print(const batch_t *batch, FILE *out);
+
+void batch_free(batch_job_t *jobs, int count);
+
+#endif // CHIP8_BATCH_H
@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8_core.h"
+#include "chip8_cache.h"
+#include "chip8_block.h"
+#include "chip8_sched.h"
+#include "chip8_variant.h"
+#include "chip8_scale.h"
+
+
+/* core benchmark, no SDL
+ * built-in loops stress one opcode class each plus a small game-like demo;
+ * roms given on the command line run as whole-program benchmarks. every
+ * case runs on each core, once to warm up and then --repeat times from a
+ * fresh machine, reporting the median with min/max over the repeats.
+ * --scale WxH times the software upscaler instead: whole frames with
+ * phosphor and scanlines on at the whole factor that fits, for each kernel.
+ */
+
+#define BENCH_DEFAULT_CYCLES 2000000
+#define BENCH_DEFAULT_REPEAT 7
+#define BENCH_MAX_REPEAT 64
+
+typedef struct {
+    const char *name;
+    const uint16_t *code;   // opcodes from 0x200
+    size_t count;
+}bench_program_t;
+
+typedef enum {
+    CORE_INTERP,
+    CORE_CACHED,
+    CORE_BLOCK,
+}bench_core_t;
+
+static const char *core_names[] = { "interp", "cached", "block" };
+
+static bool skip_idle = false;  // --idle-skip: skipped wait loop passes count as instructions run
+static chip8_variant_t variant = CHIP8_VARIANT_DEFAULT;
+
+
+// 8XYN arithmetic, 11 instructions a loop
+static const uint16_t alu[] = {
+    0x6105, 0x6203,
+    0x8124, 0x8125, 0x8126, 0x8127, 0x812E, 0x8121, 0x8122, 0x8123, 0x8120, 0x7101,
+    0x1204,
+};
+
+// DXYN over moving, wrapping positions
+static const uint16_t draw[] = {
+    0xA050, 0x6000, 0x6100,
+    0xD015, 0x7007, 0x7103, 0xD01A,
+    0x1206,
+};
+
+// FX55/FX65 block stores and loads (ram writes go through cache invalidation)
+static const uint16_t mem[] = {
+    0xA300, 0x6A07,
+    0xFF55, 0xFF65, 0xF533, 0x7501,
+    0x1204,
+};
+
+// CALL/RET, nested calls and BNNN
+static const uint16_t jumps[] = {
+    0x2208,     // 200: call 208
+    0x220A,     // 202: call 20A
+    0xB206,     // 204: jp v0 + 206
+    0x1200,     // 206: jp 200
+    0x00EE,     // 208: ret
+    0x2208,     // 20A: call 208
+    0x00EE,     // 20C: ret
+};
+
+// bouncing sprite paced by the delay timer, BCD score drawn each frame
+static const uint16_t demo[] = {
+    0x6A00, 0x6B00, 0x6C01, 0x6D01, 0x6E00,
+    0xA050, 0xDAB5,             // 20A: draw
+    0x6502, 0xF515,             // delay 2 frames
+    0xF607, 0x3600, 0x1212,     // 212: wait for DT
+    0xA050, 0xDAB5,             // erase
+    0x8AC4, 0x8BD4, 0x7E01,
+    0xA300, 0xFE33, 0xF265,     // score digits to V0..V2
+    0xF029, 0x6838, 0x6900, 0xD895, 0xD895,
+    0x120A,
+};
+
+#define PROGRAM(p) { #p, p, sizeof p / sizeof p[0] }
+
+static const bench_program_t programs[] = {
+    PROGRAM(alu),
+    PROGRAM(draw),
+    PROGRAM(mem),
+    PROGRAM(jumps),
+    PROGRAM(demo),
+};
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+// one timed run from a fresh machine, returns ns and the frames emulated
+static uint64_t run_once(const uint8_t *rom, size_t size, bench_core_t core, uint64_t cycles,
+                         void *code_cache, uint64_t *frames) {
+    chip8_t chip8 = {0};
+    chip8_load(&chip8, rom, size);
+    chip8_set_variant(&chip8, variant);
+    chip8.skip_idle = skip_idle;
+
+    if (core == CORE_CACHED) chip8_cache_attach(&chip8, code_cache);
+    else if (core == CORE_BLOCK) chip8_blocks_attach(&chip8, code_cache);
+
+    chip8_sched_t sched;
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+
+    uint64_t start = now_ns();
+    chip8_sched_run(&chip8, &sched, cycles);
+    uint64_t ns = now_ns() - start;
+
+    *frames = sched.frames;
+    return ns;
+}
+
+
+static void bench(const char *name, const uint8_t *rom, size_t size, bench_core_t core,
+                  uint64_t cycles, int repeat, void *code_cache) {
+    double ns_per[BENCH_MAX_REPEAT];
+    uint64_t frames, total = 0;
+
+    run_once(rom, size, core, cycles, code_cache, &frames);    // warm up
+
+    for (int i = 0; i < repeat; i++) {
+        uint64_t ns = run_once(rom, size, core, cycles, code_cache, &frames);
+        ns_per[i] = (double)ns / cycles;
+        total += ns;
+    }
+    qsort(ns_per, repeat, sizeof ns_per[0], cmp_double);
+
+    double median = ns_per[repeat / 2];
+    double secs = total / 1e9;
+
+    printf("%-12.12s %-7s %9.2f %9.2f %9.2f %6.1f%% %10.1f %12.0f\n",
+           name, core_names[core], median, ns_per[0], ns_per[repeat - 1],
+           100.0 * (ns_per[repeat - 1] - ns_per[0]) / median,
+           1e3 / median, frames * repeat / secs);
+}
+
+
+// a sprite moving over a cleared screen, every frame written out whole as on a redraw
+static void bench_scale(int width, int height, int repeat) {
+    int factor = width / CHIP8_HIRES_WIDTH;
+    if (height / CHIP8_HIRES_HEIGHT < factor) factor = height / CHIP8_HIRES_HEIGHT;
+    if (factor < 1) factor = 1;
+    if (factor > CHIP8_SCALE_MAX_FACTOR) factor = CHIP8_SCALE_MAX_FACTOR;
+
+    size_t pitch = CHIP8_HIRES_WIDTH * factor * sizeof(uint32_t);
+    uint32_t *out = malloc(pitch * CHIP8_HIRES_HEIGHT * factor);
+    chip8_scale_t *scale = aligned_alloc(32, sizeof *scale);
+    if (!out || !scale) exit(EXIT_FAILURE);
+
+    printf("%dx%d output, factor %d, phosphor 60%% scanlines 30%%, ms/frame\n",
+           CHIP8_HIRES_WIDTH * factor, CHIP8_HIRES_HEIGHT * factor, factor);
+    printf("%-7s %9s %9s %9s\n", "kernel", "median", "min", "max");
+
+    for (int k = 0; k < CHIP8_SCALE_KERNEL_COUNT; k++) {
+        if (!chip8_scale_supported(k)) continue;
+        chip8_scale_init(scale, k, 60, 30, 0x000000, 0xcdf7f6);
+
+        double ms[BENCH_MAX_REPEAT];
+        for (int r = -1; r < repeat; r++) {     // -1 warms up
+            chip8_screen_t screen = {0};
+            uint64_t start = now_ns();
+
+            for (int frame = 0; frame < 60; frame++) {
+                memset(&screen, 0, sizeof screen);
+                for (int y = 0; y < 8; y++)
+                    screen.rows[(frame + y) % CHIP8_HIRES_HEIGHT][0] = 0xFF00000000000000ull >> frame % 56;
+
+                chip8_scale_update(scale, &screen);
+                chip8_scale_rows(scale, factor, 0, CHIP8_HIRES_HEIGHT - 1, out, pitch);
+            }
+            if (r >= 0) ms[r] = (now_ns() - start) / 60 / 1e6;
+        }
+        qsort(ms, repeat, sizeof ms[0], cmp_double);
+        printf("%-7s %9.3f %9.3f %9.3f\n", chip8_scale_kernel_names[k], ms[repeat / 2], ms[0], ms[repeat - 1]);
+    }
+
+    free(scale);
+    free(out);
+}
+
+
+static bool load_file(const char *path, uint8_t *rom, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        CHIP8_LOG("ROM file %s not found", path);
+        return false;
+    }
+
+    *size = fread(rom, 1, CHIP8_RAM_SIZE - CHIP8_ROM_ADDR + 1, file);
+    fclose(file);
+
+    if (*size > CHIP8_RAM_SIZE - CHIP8_ROM_ADDR) {
+        CHIP8_LOG("ROM file %s too big", path);
+        return false;
+    }
+    return true;
+}
+
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--cycles N] [--repeat N] [--core interp|cached|block] [--variant V] [--idle-skip] [rom...]\n"
+                    "       %s --scale WxH [--repeat N]\n", prog, prog);
+}
+
+
+int main(int argc, char *argv[]) {
+    uint64_t cycles = BENCH_DEFAULT_CYCLES;
+    int repeat = BENCH_DEFAULT_REPEAT;
+    int only_core = -1;
+    char **roms = calloc(argc, sizeof *roms);
+    int rom_count = 0;
+    int scale_w = 0, scale_h = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            for (int c = 0; c < 3; c++)
+                if (strcmp(name, core_names[c]) == 0) only_core = c;
+            if (only_core < 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+            if (!chip8_variant_parse(argv[++i], &variant)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &scale_w, &scale_h) != 2 || scale_w < 1 || scale_h < 1) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--idle-skip") == 0) {
+            skip_idle = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            roms[rom_count++] = argv[i];
+        }
+    }
+
+    if (cycles == 0 || repeat < 1 || repeat > BENCH_MAX_REPEAT) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (scale_w) {
+        bench_scale(scale_w, scale_h, repeat);
+        free(roms);
+        return EXIT_SUCCESS;
+    }
+
+    // big enough for either code cache
+    size_t cache_size = sizeof(chip8_cache_t) > sizeof(chip8_blocks_t) ? sizeof(chip8_cache_t) : sizeof(chip8_blocks_t);
+    void *code_cache = malloc(cache_size);
+    if (!code_cache) return EXIT_FAILURE;
+
+    printf("%llu instructions x %d runs, median ns/instr with min/max and spread\n",
+           (unsigned long long)cycles, repeat);
+    printf("%-12s %-7s %9s %9s %9s %7s %10s %12s\n",
+           "program", "core", "ns/instr", "min", "max", "spread", "Minstr/s", "frames/s");
+
+    uint8_t rom[CHIP8_RAM_SIZE];
+    size_t size;
+
+    for (size_t p = 0; p < sizeof programs / sizeof programs[0]; p++) {
+        for (size_t i = 0; i < programs[p].count; i++) {
+            rom[2 * i] = programs[p].code[i] >> 8;
+            rom[2 * i + 1] = programs[p].code[i] & 0xFF;
+        }
+
+        for (int c = 0; c < 3; c++)
+            if (only_core < 0 || only_core == c)
+                bench(programs[p].name, rom, 2 * programs[p].count, c, cycles, repeat, code_cache);
+    }
+
+    for (int r = 0; r < rom_count; r++) {
+        if (!load_file(roms[r], rom, &size)) continue;
+
+        const char *name = strrchr(roms[r], '/');
+        name = name ? name + 1 : roms[r];
+
+        for (int c = 0; c < 3; c++)
+            if (only_core < 0 || only_core == c)
+                bench(name, rom, size, c, cycles, repeat, code_cache);
+    }
+
+    free(code_cache);
+    free(roms);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include <string.h>
+
+#include "chip8_block.h"
+#include "chip8_prof.h"
+#include "chip8_variant.h"
+
+
+// ops after which execution may not fall through to the next address
+static bool ends_block(uint16_t opcode, const chip8_quirks_t q) {
+    switch (opcode >> 12) {
+        case 0x0:
+            if (q.schip && (opcode & 0xFF) == 0xFD) return true;    // 00FD exit
+            return (opcode & 0xFF) == 0xEE;                 // 00EE
+        case 0x1: case 0x2: case 0xB: return true;          // jumps, call
+        case 0x3: case 0x4: case 0x5: case 0x9: return true; // skips, 5XY2 stores
+        case 0xE: return true;                              // key skips
+        case 0xF:
+            switch (opcode & 0xFF) {
+                case 0x0A:              // may rewind PC
+                case 0x33: case 0x55:   // may overwrite the code that follows
+                    return true;
+                case 0x00:              // F000 NNNN, the next word is data
+                    return q.xochip && opcode == 0xF000;
+            }
+            return false;
+    }
+    return false;
+}
+
+
+static void flush(chip8_blocks_t *blocks) {
+    memset(blocks->map, 0, sizeof blocks->map);
+    memset(blocks->code, 0, sizeof blocks->code);
+    blocks->used = 0;
+    blocks->last = NULL;
+    blocks->resume = 0;
+}
+
+
+static chip8_block_t *translate(chip8_t *chip8, uint16_t start) {
+    chip8_blocks_t *blocks = chip8->blocks;
+
+    if (blocks->used == CHIP8_BLOCK_POOL)
+        flush(blocks);
+
+    chip8_block_t *block = &blocks->pool[blocks->used++];
+    const chip8_quirks_t q = chip8_quirks[chip8->variant];
+    uint16_t addr = start;
+
+    block->start = start;
+    block->count = 0;
+    block->valid = true;
+
+    while (block->count < CHIP8_BLOCK_MAX_OPS && addr + 2 <= CHIP8_RAM_SIZE) {
+        uint16_t opcode = (chip8->ram[addr] << 8) | chip8->ram[addr + 1];
+
+        chip8_decode_op(&block->ops[block->count++], opcode, chip8->variant);
+        addr += 2;
+
+        if (ends_block(opcode, q)) break;
+    }
+
+    // an op straddling the end of ram is left to a one-op block
+    if (block->count == 0) {
+        uint16_t opcode = (chip8->ram[addr] << 8) | chip8->ram[0];
+        chip8_decode_op(&block->ops[block->count++], opcode, chip8->variant);
+        addr += 2;
+    }
+
+    block->end = addr;
+
+    for (uint16_t a = start; a < addr; a++)
+        blocks->code[(a & (CHIP8_RAM_SIZE - 1)) / 64] |= 1ull << (a % 64);
+
+    blocks->map[start] = block;
+    return block;
+}
+
+
+void chip8_blocks_attach(chip8_t *chip8, chip8_blocks_t *blocks) {
+    chip8->blocks = blocks;
+    if (blocks)
+        flush(blocks);
+}
+
+
+void chip8_blocks_invalidate(chip8_blocks_t *blocks, uint16_t addr, uint16_t len) {
+    bool hit = false;
+
+    // a word of the bitmap at a time
+    for (int a = addr; a < addr + len && !hit; a = (a | 63) + 1) {
+        int i = a & (CHIP8_RAM_SIZE - 1);
+        int n = addr + len - a < 64 - i % 64 ? addr + len - a : 64 - i % 64;
+        uint64_t bits = n == 64 ? ~0ull : ((1ull << n) - 1) << (i % 64);
+        hit = blocks->code[i / 64] & bits;
+    }
+
+    if (!hit) return;   // plain data write
+
+    // every valid block is in the map at its start, and none starts more
+    // than a full block before the write
+    for (int a = addr - 2 * CHIP8_BLOCK_MAX_OPS + 1; a < addr + len; a++) {
+        chip8_block_t *block = blocks->map[a & (CHIP8_RAM_SIZE - 1)];
+
+        if (block && block->start < addr + len && addr < block->end) {
+            block->valid = false;
+            blocks->map[block->start] = NULL;
+        }
+    }
+}
+
+
+void chip8_run_blocks(chip8_t *chip8, uint32_t cycles) {
+    chip8_blocks_t *blocks = chip8->blocks;
+    chip8_block_t *block = blocks->last;
+    uint32_t first = blocks->resume;
+
+    // the rest of a block the last slice stopped in
+    if (!first || !block || !block->valid || chip8->PC != block->start + 2 * first) {
+        block = NULL;
+        first = 0;
+    }
+    blocks->resume = 0;
+
+    while (cycles) {
+        CHIP8_TRAP_IF(chip8, chip8->PC > CHIP8_RAM_SIZE - 2, CHIP8_FAULT_PC);
+
+        if (!block) {
+            uint16_t pc = chip8->PC & (CHIP8_RAM_SIZE - 1);
+            block = blocks->map[pc];
+            if (!block) block = translate(chip8, pc);
+        }
+
+        uint32_t n = block->count - first <= cycles ? block->count - first : cycles;
+        chip8_op_t *op = block->ops + first;
+
+        for (uint32_t i = first; i < first + n; i++, op++) {
+            chip8->PC += 2;
+            CHIP8_PROF_OP(chip8, block->start + 2 * i, op->opcode);
+            op->handler(chip8, op);
+            if (CHIP8_FAULTED(chip8)) return;
+        }
+
+        cycles -= n;
+        if (first + n < block->count) {
+            blocks->last = block;
+            blocks->resume = first + n;
+        }
+        block = NULL;
+        first = 0;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CHIP8_BLOCK_H
+#define CHIP8_BLOCK_H
+
+#include "chip8_cache.h"
+
+
+/* basic-block translator (threaded code)
+ * straight-line runs of opcodes are translated once into arrays of decoded
+ * ops that end at the first branch, skip, FX0A or ram store, found through
+ * a map by start address. a slice ending inside a block picks up there on
+ * the next call instead of translating a new block from the middle.
+ * CHIP-8 blocks are short (a couple of ops on branchy code), so per block
+ * work beyond the map load costs more than it saves: this is about as fast
+ * as the cached core on straight-line code and slower on call/jump-heavy
+ * code, where the cached core stays the better pick.
+ * FX33/FX55 writes over translated bytes throw the affected blocks away.
+ */
+
+#define CHIP8_BLOCK_MAX_OPS 32
+#define CHIP8_BLOCK_POOL 1024   // translations kept before a full flush
+
+typedef struct chip8_block chip8_block_t;
+
+struct chip8_block {
+    uint16_t start;     // ram address of the first op
+    uint16_t end;       // one past the last translated byte
+    uint16_t count;
+    bool valid;
+    chip8_op_t ops[CHIP8_BLOCK_MAX_OPS];
+};
+
+struct chip8_blocks {
+    chip8_block_t *map[CHIP8_RAM_SIZE];    // block starting at each address
+    uint64_t code[CHIP8_RAM_SIZE / 64];    // bit per ram byte covered by a translation
+    uint16_t used;
+    chip8_block_t *last;    // block the last slice ended inside, if any
+    uint16_t resume;        // ops of it already run
+    chip8_block_t pool[CHIP8_BLOCK_POOL];
+};
+
+
+// attach a translator to the machine (NULL detaches), starts empty
+void chip8_blocks_attach(chip8_t *chip8, chip8_blocks_t *blocks);
+
+// drop translations overlapping ram[addr .. addr + len - 1]
+void chip8_blocks_invalidate(chip8_blocks_t *blocks, uint16_t addr, uint16_t len);
+
+// run cycles instructions through translated blocks
+void chip8_run_blocks(chip8_t *chip8, uint32_t cycles);
+
+#endif // CHIP8_BLOCK_H
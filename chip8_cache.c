@@ -0,0 +1,387 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_cache.h"
+#include "chip8_prof.h"
+#include "chip8_variant.h"
+
+
+/* handlers mirror compute_instruction case by case, PC already points
+ * past the instruction when they run. ops whose behaviour depends on the
+ * variant get one handler per variant, picked at decode time
+ */
+
+static void op_decode(chip8_t *chip8, chip8_op_t *op);
+
+
+static void op_sys(chip8_t *chip8, chip8_op_t *op) {
+    (void)chip8;
+    (void)op;
+    CHIP8_OP_LOG("SYS call 0x%03X ignored", op->NNN);
+}
+
+static void op_unknown(chip8_t *chip8, chip8_op_t *op) {
+    (void)chip8;
+    (void)op;
+    CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+}
+
+static void op_00e0(chip8_t *chip8, chip8_op_t *op) {   // CLS
+    (void)op;
+    memset(chip8->display, 0, sizeof(chip8->display));
+    chip8->dirty_rows = ~0u;
+}
+
+static void op_00ee(chip8_t *chip8, chip8_op_t *op) {   // RET
+    (void)op;
+    CHIP8_TRAP_IF(chip8, chip8->stack_pointer == 0, CHIP8_FAULT_STACK_UNDERFLOW);
+    chip8->PC = chip8->stack[--chip8->stack_pointer];
+}
+
+static void op_1nnn(chip8_t *chip8, chip8_op_t *op) {   // JP addr
+    chip8->PC = op->NNN;
+}
+
+static void op_2nnn(chip8_t *chip8, chip8_op_t *op) {   // CALL addr
+    CHIP8_TRAP_IF(chip8, chip8->stack_pointer >= CHIP8_STACK_DEPTH, CHIP8_FAULT_STACK_OVERFLOW);
+    chip8->stack[chip8->stack_pointer++] = chip8->PC;
+    chip8->PC = op->NNN;
+}
+
+static void op_6xnn(chip8_t *chip8, chip8_op_t *op) {   // LD Vx, NN
+    chip8->V_reg[op->X] = op->NN;
+}
+
+static void op_7xnn(chip8_t *chip8, chip8_op_t *op) {   // ADD Vx, NN
+    chip8->V_reg[op->X] += op->NN;
+}
+
+static void op_8xy0(chip8_t *chip8, chip8_op_t *op) {   // LD
+    chip8->V_reg[op->X] = chip8->V_reg[op->Y];
+}
+
+static void op_8xy4(chip8_t *chip8, chip8_op_t *op) {   // ADD
+    uint8_t *V = chip8->V_reg;
+    uint16_t sum = V[op->X] + V[op->Y];
+    V[0xF] = sum > 0xFF;
+    V[op->X] = sum & 0xFF;
+}
+
+static void op_8xy5(chip8_t *chip8, chip8_op_t *op) {   // SUB
+    uint8_t *V = chip8->V_reg;
+    V[0xF] = V[op->X] > V[op->Y];
+    V[op->X] -= V[op->Y];
+}
+
+static void op_8xy7(chip8_t *chip8, chip8_op_t *op) {   // SUBN
+    uint8_t *V = chip8->V_reg;
+    V[0xF] = V[op->Y] > V[op->X];
+    V[op->X] = V[op->Y] - V[op->X];
+}
+
+static void op_annn(chip8_t *chip8, chip8_op_t *op) {   // LD I, addr
+    chip8->I = op->NNN;
+}
+
+static void op_cxnn(chip8_t *chip8, chip8_op_t *op) {   // RND Vx, byte
+    chip8->V_reg[op->X] = chip8_rand(chip8) & op->NN;
+}
+
+static void op_dxyn(chip8_t *chip8, chip8_op_t *op) {   // DRW Vx, Vy, N
+    uint8_t *V = chip8->V_reg;
+    uint8_t x = V[op->X] % CHIP8_WIDTH;
+    uint8_t y = V[op->Y] % CHIP8_HEIGHT;
+
+    CHIP8_CHECK_RAM(chip8, chip8->I, op->N);
+    V[0xF] = 0; // reset collision flag
+
+    for (int row = 0; row < op->N; row++) {
+        uint64_t bits = chip8_sprite_row(chip8->ram[chip8->I + row], x);
+        int py = (y + row) % CHIP8_HEIGHT;
+        uint64_t *line = &chip8->display[py];
+
+        if (*line & bits)
+            V[0xF] = 1; // collision
+
+        *line ^= bits;
+        chip8->dirty_rows |= 1u << py;
+    }
+}
+
+static void op_fx07(chip8_t *chip8, chip8_op_t *op) {   // VX = delay timer
+    chip8->V_reg[op->X] = chip8->timer1;
+}
+
+static void op_fx0a(chip8_t *chip8, chip8_op_t *op) {   // VX = get key
+    for (uint8_t i = 0; i < sizeof chip8->keyboard; i++) {
+        if (chip8->keyboard[i]) {
+            chip8->V_reg[op->X] = i;
+            return;
+        }
+    }
+
+    chip8->PC -= 2; //keep same opcode if not pressed
+}
+
+static void op_fx15(chip8_t *chip8, chip8_op_t *op) {   // delay timer = VX
+    chip8->timer1 = chip8->V_reg[op->X];
+}
+
+static void op_fx18(chip8_t *chip8, chip8_op_t *op) {   // audio timer = VX
+    chip8->timer2 = chip8->V_reg[op->X];
+}
+
+static void op_fx1e(chip8_t *chip8, chip8_op_t *op) {   // I += VX
+    chip8->I += chip8->V_reg[op->X];
+}
+
+static void op_fx29(chip8_t *chip8, chip8_op_t *op) {   // I = sprite for char in VX
+    chip8->I = CHIP8_FONT_ADDR + chip8->V_reg[op->X] * 5;
+}
+
+static void op_fx33(chip8_t *chip8, chip8_op_t *op) {   // BCD
+    uint8_t vx = chip8->V_reg[op->X];
+    CHIP8_CHECK_RAM(chip8, chip8->I, 3);
+    chip8->ram[chip8->I] = vx / 100;
+    chip8->ram[chip8->I + 1] = (vx / 10) % 10;
+    chip8->ram[chip8->I + 2] = vx % 10;
+    chip8_ram_written(chip8, chip8->I, 3);
+}
+
+
+// SCHIP / XO-CHIP extras, only decoded for those variants
+static void op_00e0_hires(chip8_t *chip8, chip8_op_t *op) {    // CLS either plane
+    (void)op;
+    chip8_clear(chip8);
+}
+
+static void op_00cn(chip8_t *chip8, chip8_op_t *op) {   // scroll down N
+    chip8_scroll(chip8, op->N, 0);
+}
+
+static void op_00dn(chip8_t *chip8, chip8_op_t *op) {   // scroll up N
+    chip8_scroll(chip8, -op->N, 0);
+}
+
+static void op_00fb(chip8_t *chip8, chip8_op_t *op) {   // scroll right 4
+    (void)op;
+    chip8_scroll(chip8, 0, 4);
+}
+
+static void op_00fc(chip8_t *chip8, chip8_op_t *op) {   // scroll left 4
+    (void)op;
+    chip8_scroll(chip8, 0, -4);
+}
+
+static void op_00fd(chip8_t *chip8, chip8_op_t *op) {   // exit, stays on this op
+    (void)op;
+    chip8->PC -= 2;
+    chip8->state = QUIT;
+}
+
+static void op_00fe(chip8_t *chip8, chip8_op_t *op) {   // lores
+    (void)op;
+    chip8_set_hires(chip8, false);
+}
+
+static void op_00ff(chip8_t *chip8, chip8_op_t *op) {   // hires
+    (void)op;
+    chip8_set_hires(chip8, true);
+}
+
+static void op_5xy2(chip8_t *chip8, chip8_op_t *op) {   // store VX..VY at I
+    int dir = op->X <= op->Y ? 1 : -1;
+    int n = abs(op->Y - op->X) + 1;
+    CHIP8_CHECK_RAM(chip8, chip8->I, n);
+    for (int i = 0; i < n; i++)
+        chip8->ram[chip8->I + i] = chip8->V_reg[op->X + i * dir];
+    chip8_ram_written(chip8, chip8->I, n);
+}
+
+static void op_5xy3(chip8_t *chip8, chip8_op_t *op) {   // load VX..VY from I
+    int dir = op->X <= op->Y ? 1 : -1;
+    int n = abs(op->Y - op->X) + 1;
+    CHIP8_CHECK_RAM(chip8, chip8->I, n);
+    for (int i = 0; i < n; i++)
+        chip8->V_reg[op->X + i * dir] = chip8->ram[chip8->I + i];
+}
+
+static void op_f000(chip8_t *chip8, chip8_op_t *op) {   // I = NNNN from the next word
+    (void)op;
+    chip8->I = ((chip8->ram[chip8->PC & (CHIP8_RAM_SIZE - 1)] << 8) |
+                chip8->ram[(chip8->PC + 1) & (CHIP8_RAM_SIZE - 1)]) & (CHIP8_RAM_SIZE - 1);
+    chip8->PC += 2;
+}
+
+static void op_fx30(chip8_t *chip8, chip8_op_t *op) {   // I = big digit VX
+    chip8->I = CHIP8_BIG_FONT_ADDR + (chip8->V_reg[op->X] & 0xF) * 10;
+}
+
+static void op_fx75(chip8_t *chip8, chip8_op_t *op) {   // V0..VX to flags
+    memcpy(chip8->flags, chip8->V_reg, op->X + 1);
+}
+
+static void op_fx85(chip8_t *chip8, chip8_op_t *op) {   // flags to V0..VX
+    memcpy(chip8->V_reg, chip8->flags, op->X + 1);
+}
+
+
+// quirk dependent handlers, one set per variant
+typedef struct {
+    chip8_handler_t se_nn, sne_nn, se_xy, sne_xy, skp, sknp;
+    chip8_handler_t or, and, xor, shr, shl;
+    chip8_handler_t jump, draw, store, load;
+}variant_ops_t;
+
+#define VARIANT_HANDLERS(name, q) \
+    static void op_3xnn_##name(chip8_t *chip8, chip8_op_t *op) { if (chip8->V_reg[op->X] == op->NN) chip8_skip(chip8, q); } \
+    static void op_4xnn_##name(chip8_t *chip8, chip8_op_t *op) { if (chip8->V_reg[op->X] != op->NN) chip8_skip(chip8, q); } \
+    static void op_5xy0_##name(chip8_t *chip8, chip8_op_t *op) { if (chip8->V_reg[op->X] == chip8->V_reg[op->Y]) chip8_skip(chip8, q); } \
+    static void op_9xy0_##name(chip8_t *chip8, chip8_op_t *op) { if (chip8->V_reg[op->X] != chip8->V_reg[op->Y]) chip8_skip(chip8, q); } \
+    static void op_ex9e_##name(chip8_t *chip8, chip8_op_t *op) { \
+        CHIP8_TRAP_IF(chip8, chip8->V_reg[op->X] > 0xF, CHIP8_FAULT_KEY); \
+        if (chip8->keyboard[chip8->V_reg[op->X] & 0xF]) chip8_skip(chip8, q); } \
+    static void op_exa1_##name(chip8_t *chip8, chip8_op_t *op) { \
+        CHIP8_TRAP_IF(chip8, chip8->V_reg[op->X] > 0xF, CHIP8_FAULT_KEY); \
+        if (!chip8->keyboard[chip8->V_reg[op->X] & 0xF]) chip8_skip(chip8, q); } \
+    static void op_8xy1_##name(chip8_t *chip8, chip8_op_t *op) { chip8->V_reg[op->X] |= chip8->V_reg[op->Y]; chip8_logic_vf(chip8, q); } \
+    static void op_8xy2_##name(chip8_t *chip8, chip8_op_t *op) { chip8->V_reg[op->X] &= chip8->V_reg[op->Y]; chip8_logic_vf(chip8, q); } \
+    static void op_8xy3_##name(chip8_t *chip8, chip8_op_t *op) { chip8->V_reg[op->X] ^= chip8->V_reg[op->Y]; chip8_logic_vf(chip8, q); } \
+    static void op_8xy6_##name(chip8_t *chip8, chip8_op_t *op) { chip8_shr(chip8, op->X, op->Y, q); } \
+    static void op_8xye_##name(chip8_t *chip8, chip8_op_t *op) { chip8_shl(chip8, op->X, op->Y, q); } \
+    static void op_bnnn_##name(chip8_t *chip8, chip8_op_t *op) { chip8_jump_offset(chip8, op->NNN, q); } \
+    static void op_dxyn_##name(chip8_t *chip8, chip8_op_t *op) { chip8_draw(chip8, op->X, op->Y, op->N, q); } \
+    static void op_fx55_##name(chip8_t *chip8, chip8_op_t *op) { chip8_store(chip8, op->X, q); } \
+    static void op_fx65_##name(chip8_t *chip8, chip8_op_t *op) { chip8_load_regs(chip8, op->X, q); }
+#define HANDLERS_OF(name, id, ...) VARIANT_HANDLERS(name, CHIP8_QUIRKS(__VA_ARGS__))
+CHIP8_VARIANTS(HANDLERS_OF)
+
+#define VARIANT_OPS(name, id, ...) [id] = { \
+    op_3xnn_##name, op_4xnn_##name, op_5xy0_##name, op_9xy0_##name, op_ex9e_##name, op_exa1_##name, \
+    op_8xy1_##name, op_8xy2_##name, op_8xy3_##name, op_8xy6_##name, op_8xye_##name, \
+    op_bnnn_##name, op_dxyn_##name, op_fx55_##name, op_fx65_##name },
+static const variant_ops_t variant_ops[CHIP8_VARIANT_COUNT] = { CHIP8_VARIANTS(VARIANT_OPS) };
+
+
+// pick the handler for an opcode, same split as compute_instruction
+static chip8_handler_t decode(uint16_t opcode, chip8_variant_t variant) {
+    const variant_ops_t *v = &variant_ops[variant];
+    const chip8_quirks_t q = chip8_quirks[variant];
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if ((opcode & 0xFF) == 0xE0) return q.schip ? op_00e0_hires : op_00e0;
+            if ((opcode & 0xFF) == 0xEE) return op_00ee;
+            if (q.schip) {
+                switch (opcode & 0xFF) {
+                    case 0xFB: return op_00fb;
+                    case 0xFC: return op_00fc;
+                    case 0xFD: return op_00fd;
+                    case 0xFE: return op_00fe;
+                    case 0xFF: return op_00ff;
+                }
+                if ((opcode & 0xF0) == 0xC0) return op_00cn;
+            }
+            if (q.xochip && (opcode & 0xF0) == 0xD0) return op_00dn;
+            return op_sys;
+        case 0x1: return op_1nnn;
+        case 0x2: return op_2nnn;
+        case 0x3: return v->se_nn;
+        case 0x4: return v->sne_nn;
+        case 0x5:
+            if ((opcode & 0xF) == 0) return v->se_xy;
+            if (q.xochip && (opcode & 0xF) == 2) return op_5xy2;
+            if (q.xochip && (opcode & 0xF) == 3) return op_5xy3;
+            return op_unknown;
+        case 0x6: return op_6xnn;
+        case 0x7: return op_7xnn;
+        case 0x8:
+            switch (opcode & 0xF) {
+                case 0x0: return op_8xy0;
+                case 0x1: return v->or;
+                case 0x2: return v->and;
+                case 0x3: return v->xor;
+                case 0x4: return op_8xy4;
+                case 0x5: return op_8xy5;
+                case 0x6: return v->shr;
+                case 0x7: return op_8xy7;
+                case 0xE: return v->shl;
+                default: return op_unknown;
+            }
+        case 0x9: return (opcode & 0xF) == 0 ? v->sne_xy : op_unknown;
+        case 0xA: return op_annn;
+        case 0xB: return v->jump;
+        case 0xC: return op_cxnn;
+        case 0xD: return variant == CHIP8_VARIANT_DEFAULT ? op_dxyn : v->draw;
+        case 0xE:
+            if ((opcode & 0xFF) == 0x9E) return v->skp;
+            if ((opcode & 0xFF) == 0xA1) return v->sknp;
+            return op_unknown;
+        case 0xF:
+            switch (opcode & 0xFF) {
+                case 0x07: return op_fx07;
+                case 0x0A: return op_fx0a;
+                case 0x15: return op_fx15;
+                case 0x18: return op_fx18;
+                case 0x1E: return op_fx1e;
+                case 0x29: return op_fx29;
+                case 0x33: return op_fx33;
+                case 0x55: return v->store;
+                case 0x65: return v->load;
+                case 0x30: return q.schip ? op_fx30 : op_unknown;
+                case 0x75: return q.schip ? op_fx75 : op_unknown;
+                case 0x85: return q.schip ? op_fx85 : op_unknown;
+                case 0x00: return q.xochip && opcode == 0xF000 ? op_f000 : op_unknown;
+                default: return op_unknown;
+            }
+    }
+    return op_unknown;
+}
+
+
+void chip8_decode_op(chip8_op_t *op, uint16_t opcode, chip8_variant_t variant) {
+    op->handler = decode(opcode, variant);
+    op->opcode = opcode;
+    op->NNN = opcode & 0x0FFF;
+    op->NN = opcode & 0x00FF;
+    op->N = opcode & 0x000F;
+    op->X = (opcode >> 8) & 0x000F;
+    op->Y = (opcode >> 4) & 0x000F;
+}
+
+
+// first execution of an address: decode, fill the entry, run it
+static void op_decode(chip8_t *chip8, chip8_op_t *op) {
+    uint16_t addr = (chip8->PC - 2) & (CHIP8_RAM_SIZE - 1);
+
+    chip8_decode_op(op, (chip8->ram[addr] << 8) | chip8->ram[(addr + 1) & (CHIP8_RAM_SIZE - 1)], chip8->variant);
+    op->handler(chip8, op);
+}
+
+
+void chip8_cache_attach(chip8_t *chip8, chip8_cache_t *cache) {
+    chip8->cache = cache;
+    if (cache)
+        chip8_cache_invalidate(cache, 0, CHIP8_RAM_SIZE);
+}
+
+
+void chip8_cache_invalidate(chip8_cache_t *cache, uint16_t addr, uint16_t len) {
+    // the op starting one byte earlier also reads ram[addr]
+    for (int i = (int)addr - 1; i < (int)addr + len; i++)
+        cache->ops[i & (CHIP8_RAM_SIZE - 1)].handler = op_decode;
+}
+
+
+void chip8_run_cached(chip8_t *chip8, uint32_t cycles) {
+    chip8_op_t *ops = chip8->cache->ops;
+
+    while (cycles--) {
+        CHIP8_TRAP_IF(chip8, chip8->PC > CHIP8_RAM_SIZE - 2, CHIP8_FAULT_PC);
+        chip8_op_t *op = &ops[chip8->PC & (CHIP8_RAM_SIZE - 1)];
+        chip8->PC += 2;
+        op->handler(chip8, op);
+        CHIP8_PROF_OP(chip8, op - ops, op->opcode);    // after, so a first run is counted decoded
+        if (CHIP8_FAULTED(chip8)) return;
+    }
+}
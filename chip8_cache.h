@@ -0,0 +1,42 @@
+#ifndef CHIP8_CACHE_H
+#define CHIP8_CACHE_H
+
+#include "chip8_core.h"
+
+
+/* pre-decoded instruction cache
+ * one entry per ram address (even and odd, roms may jump to odd addresses),
+ * decoded lazily on first execution and reset when FX33/FX55 write over it
+ */
+
+typedef struct chip8_op chip8_op_t;
+typedef void (*chip8_handler_t)(chip8_t *chip8, chip8_op_t *op);
+
+struct chip8_op {
+    chip8_handler_t handler;
+    uint16_t opcode;
+    uint16_t NNN;   // constants
+    uint8_t NN;
+    uint8_t N;
+    uint8_t X;  //identifiers
+    uint8_t Y;
+};
+
+struct chip8_cache {
+    chip8_op_t ops[CHIP8_RAM_SIZE];
+};
+
+
+// fill op with the handler and operands for opcode on variant
+void chip8_decode_op(chip8_op_t *op, uint16_t opcode, chip8_variant_t variant);
+
+// attach a cache to the machine (NULL detaches), starts fully invalidated
+void chip8_cache_attach(chip8_t *chip8, chip8_cache_t *cache);
+
+// forget decoded ops overlapping ram[addr .. addr + len - 1]
+void chip8_cache_invalidate(chip8_cache_t *cache, uint16_t addr, uint16_t len);
+
+// run cycles instructions through the attached cache
+void chip8_run_cached(chip8_t *chip8, uint32_t cycles);
+
+#endif // CHIP8_CACHE_H
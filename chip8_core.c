@@ -0,0 +1,610 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_core.h"
+#include "chip8_cache.h"
+#include "chip8_block.h"
+#include "chip8_prof.h"
+#include "chip8_idle.h"
+#include "chip8_variant.h"
+#include "chip8_trace.h"
+#include "chip8_debug.h"
+
+
+// chip8 initialization from a rom image in memory
+bool chip8_load(chip8_t *chip8, const uint8_t *rom, size_t rom_size) {
+    // load font
+    const uint8_t font[] = {
+            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+            0x20, 0x60, 0x20, 0x20, 0x70, // 1
+            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    };
+
+    memcpy(&chip8->ram[CHIP8_FONT_ADDR], font, sizeof(font));
+
+    if (rom_size > CHIP8_RAM_SIZE - CHIP8_ROM_ADDR) {
+        CHIP8_LOG("ROM too big");
+        return false;
+    }
+    memcpy(&chip8->ram[CHIP8_ROM_ADDR], rom, rom_size);
+
+    // defaults
+    chip8->state = RUNNING;
+    chip8->PC = CHIP8_ROM_ADDR;
+    chip8->stack_pointer = 0;
+    chip8->fault = CHIP8_FAULT_NONE;
+    chip8->dirty_rows = ~0u;    // first frame is always drawn
+    chip8->skip_idle = true;
+    chip8_seed(chip8, 1);
+
+    return true;
+}
+
+
+bool init_chip(chip8_t *chip8, char rom_name[]){
+    //load rom
+
+    FILE *rom = fopen(rom_name, "rb");
+    if(!rom) {
+        CHIP8_LOG("ROM file %s not found", rom_name);
+        return false;
+    }
+
+
+    fseek(rom, 0, SEEK_END);
+    const size_t rom_size = ftell(rom);
+    fseek(rom,0,SEEK_SET);
+
+    uint8_t image[CHIP8_RAM_SIZE - CHIP8_ROM_ADDR];
+    if(rom_size > sizeof image){
+            CHIP8_LOG("ROM file %s too big", rom_name);
+            fclose(rom);
+            return false;
+    }
+
+    if(fread(image, rom_size, 1, rom) != 1){
+        CHIP8_LOG("Could not read file into chip memory");
+        fclose(rom);
+        return false;
+    }
+
+    fclose(rom);
+
+    chip8->rom_name = rom_name;
+    return chip8_load(chip8, image, rom_size);
+}
+
+
+// fetch, decode and execute one instruction with the quirks of one variant,
+// instantiated per variant below so every q.* test folds away
+CHIP8_INLINE void step(chip8_t *chip8, const chip8_quirks_t q) {
+    // FETCH
+    CHIP8_TRAP_IF(chip8, chip8->PC > CHIP8_RAM_SIZE - 2, CHIP8_FAULT_PC);
+    chip8->instruction.opcode = (chip8->ram[chip8->PC] << 8) | chip8->ram[chip8->PC + 1];
+    chip8->PC += 2;
+
+    // DECODE
+    uint16_t opcode = chip8->instruction.opcode;
+    CHIP8_PROF_OP(chip8, chip8->PC - 2, opcode);
+    chip8->instruction.NNN = opcode & 0x0FFF;
+    chip8->instruction.NN = opcode & 0x00FF;
+    chip8->instruction.N = opcode & 0x000F;
+    chip8->instruction.X = (opcode >> 8) & 0x000F;
+    chip8->instruction.Y = (opcode >> 4) & 0x000F;
+
+    uint8_t *V = chip8->V_reg;
+
+    // EXECUTE
+    switch ((opcode >> 12) & 0x000F) {
+        case 0x0:
+            switch (chip8->instruction.NN) {
+                case 0xE0: // 00E0: CLS - clear screen
+                    if (q.schip) {
+                        chip8_clear(chip8);
+                        break;
+                    }
+                    memset(chip8->display, 0, sizeof(chip8->display));
+                    chip8->dirty_rows = ~0u;
+                    break;
+                case 0xEE: // 00EE: RET - return from subroutine
+                    CHIP8_TRAP_IF(chip8, chip8->stack_pointer == 0, CHIP8_FAULT_STACK_UNDERFLOW);
+                    chip8->PC = chip8->stack[--chip8->stack_pointer];
+                    break;
+                case 0xFB: case 0xFC: case 0xFD: case 0xFE: case 0xFF:
+                    if (!q.schip) goto sys;
+                    switch (chip8->instruction.NN) {
+                        case 0xFB: chip8_scroll(chip8, 0, 4); break;    // 00FB: scroll right
+                        case 0xFC: chip8_scroll(chip8, 0, -4); break;   // 00FC: scroll left
+                        case 0xFD: chip8->PC -= 2; chip8->state = QUIT; break;   // 00FD: exit, stays put
+                        case 0xFE: chip8_set_hires(chip8, false); break; // 00FE: lores
+                        case 0xFF: chip8_set_hires(chip8, true); break; // 00FF: hires
+                    }
+                    break;
+                default:
+                    if (q.schip && (chip8->instruction.NN & 0xF0) == 0xC0) {     // 00CN: scroll down
+                        chip8_scroll(chip8, chip8->instruction.N, 0);
+                        break;
+                    }
+                    if (q.xochip && (chip8->instruction.NN & 0xF0) == 0xD0) {    // 00DN: scroll up
+                        chip8_scroll(chip8, -chip8->instruction.N, 0);
+                        break;
+                    }
+                sys:
+                    CHIP8_OP_LOG("SYS call 0x%03X ignored", chip8->instruction.NNN);
+                    break;
+            }
+            break;
+
+        case 0x1: // 1NNN: JP addr
+            chip8->PC = chip8->instruction.NNN;
+            break;
+
+        case 0x2: // 2NNN: CALL addr
+            CHIP8_TRAP_IF(chip8, chip8->stack_pointer >= CHIP8_STACK_DEPTH, CHIP8_FAULT_STACK_OVERFLOW);
+            chip8->stack[chip8->stack_pointer++] = chip8->PC;
+
+            chip8->PC = chip8->instruction.NNN;
+            break;
+
+        case 0x3: // 3XNN: SE Vx, NN
+            if (V[chip8->instruction.X] == chip8->instruction.NN)
+                chip8_skip(chip8, q);
+            break;
+
+        case 0x4: // 4XNN: SNE Vx, NN
+            if (V[chip8->instruction.X] != chip8->instruction.NN)
+                chip8_skip(chip8, q);
+            break;
+
+        case 0x5: { // 5XY0: Skip next if Vx == Vy
+            uint8_t X = chip8->instruction.X;
+            uint8_t Y = chip8->instruction.Y;
+            int dir = X <= Y ? 1 : -1;
+
+            if (chip8->instruction.N == 0) {
+                if (V[X] == V[Y]) chip8_skip(chip8, q);
+            } else if (q.xochip && chip8->instruction.N == 2) { // 5XY2: store VX..VY at I
+                CHIP8_CHECK_RAM(chip8, chip8->I, abs(Y - X) + 1);
+                for (int i = 0; i <= abs(Y - X); i++)
+                    chip8->ram[chip8->I + i] = V[X + i * dir];
+                chip8_ram_written(chip8, chip8->I, abs(Y - X) + 1);
+            } else if (q.xochip && chip8->instruction.N == 3) { // 5XY3: load VX..VY from I
+                CHIP8_CHECK_RAM(chip8, chip8->I, abs(Y - X) + 1);
+                for (int i = 0; i <= abs(Y - X); i++)
+                    V[X + i * dir] = chip8->ram[chip8->I + i];
+            } else {
+                CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+            }
+            break;
+        }
+
+        case 0x6: // 6XNN: LD Vx, NN
+            V[chip8->instruction.X] = chip8->instruction.NN;
+            break;
+
+        case 0x7: // 7XNN: ADD Vx, NN
+            V[chip8->instruction.X] += chip8->instruction.NN;
+            break;
+
+        case 0x8: { // Arithmetic and bitwise ops
+            uint8_t X = chip8->instruction.X;
+            uint8_t Y = chip8->instruction.Y;
+
+            switch (chip8->instruction.N) {
+                case 0x0:
+                    V[X] = V[Y];
+                    break;                          // 8XY0: LD
+                case 0x1:
+                    V[X] |= V[Y];
+                    chip8_logic_vf(chip8, q);
+                    break;                         // 8XY1: OR
+                case 0x2:
+                    V[X] &= V[Y];
+                    chip8_logic_vf(chip8, q);
+                    break;                         // 8XY2: AND
+                case 0x3:
+                    V[X] ^= V[Y];
+                    chip8_logic_vf(chip8, q);
+                    break;                         // 8XY3: XOR
+                case 0x4: {                                            // 8XY4: ADD
+                    uint16_t sum = V[X] + V[Y];
+                    V[0xF] = sum > 0xFF;
+                    V[X] = sum & 0xFF;
+                    break;
+                }
+                case 0x5:                                              // 8XY5: SUB
+                    V[0xF] = V[X] > V[Y];
+                    V[X] -= V[Y];
+                    break;
+                case 0x6:                                              // 8XY6: SHR
+                    chip8_shr(chip8, X, Y, q);
+                    break;
+                case 0x7:                                              // 8XY7: SUBN
+                    V[0xF] = V[Y] > V[X];
+                    V[X] = V[Y] - V[X];
+                    break;
+                case 0xE:                                              // 8XYE: SHL
+                    chip8_shl(chip8, X, Y, q);
+                    break;
+                default:
+                    CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+            }
+            break;
+        }
+
+        case 0x9: // 9XY0: Skip next if Vx != Vy
+            CHIP8_TRAP_IF(chip8, chip8->instruction.N != 0, CHIP8_FAULT_OPCODE);
+            if (chip8->instruction.N == 0 &&
+                V[chip8->instruction.X] != V[chip8->instruction.Y])
+                chip8_skip(chip8, q);
+            break;
+
+        case 0xA: // ANNN: LD I, addr
+            chip8->I = chip8->instruction.NNN;
+            break;
+
+        case 0xB: // BNNN: JP V0 + addr (BXNN: XNN + VX)
+            chip8_jump_offset(chip8, chip8->instruction.NNN, q);
+            break;
+
+        case 0xC: // CXNN: RND Vx, byte
+            V[chip8->instruction.X] = chip8_rand(chip8) & chip8->instruction.NN;
+            break;
+
+        case 0xD: { // DXYN: DRW Vx, Vy, N (draw sprite)
+            if (q.clip || q.schip) {
+                chip8_draw(chip8, chip8->instruction.X, chip8->instruction.Y, chip8->instruction.N, q);
+                break;
+            }
+
+            uint8_t x = V[chip8->instruction.X] % CHIP8_WIDTH;
+            uint8_t y = V[chip8->instruction.Y] % CHIP8_HEIGHT;
+            uint8_t height = opcode & 0x000F;
+
+            CHIP8_CHECK_RAM(chip8, chip8->I, height);
+            V[0xF] = 0; // reset collision flag
+
+            for (int row = 0; row < height; row++) {
+                uint64_t bits = chip8_sprite_row(chip8->ram[chip8->I + row], x);
+                int py = (y + row) % CHIP8_HEIGHT;
+                uint64_t *line = &chip8->display[py];
+
+                if (*line & bits)
+                    V[0xF] = 1; // collision
+
+                *line ^= bits;
+                chip8->dirty_rows |= 1u << py;
+            }
+            break;
+
+
+        }
+            break;
+
+
+
+        case 0xE: { // Key operations
+            uint8_t X = chip8->instruction.X;
+            switch (chip8->instruction.NN) {
+                case 0x9E: // EX9E: Skip next if key VX pressed
+                    CHIP8_TRAP_IF(chip8, V[X] > 0xF, CHIP8_FAULT_KEY);
+                    if (chip8->keyboard[V[X] & 0xF]) chip8_skip(chip8, q);
+                    break;
+                case 0xA1: // EXA1: Skip next if key VX not pressed
+                    CHIP8_TRAP_IF(chip8, V[X] > 0xF, CHIP8_FAULT_KEY);
+                    if (!chip8->keyboard[V[X] & 0xF]) chip8_skip(chip8, q);
+                    break;
+                default:
+                    CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+            }
+            break;
+        }
+
+
+        case 0xF: {
+            switch (chip8->instruction.NN) {
+                case 0x0A: {
+                    //0xF0A: VX = get key
+                    bool key_pressed = false;
+                    for (uint8_t i = 0; i < sizeof chip8->keyboard; i++) {
+                        if (chip8->keyboard[i]) {
+                            V[chip8->instruction.X] = i;
+                            key_pressed = true;
+                            break;
+                        }
+                    }
+
+                    if (!key_pressed){
+                        chip8->PC -= 2;
+                        return; //keep same opcode if not pressed
+                        }
+                    break;
+                }
+
+
+                case 0x1E:
+                    // I += VX;
+                    chip8->I += V[chip8->instruction.X];
+                    break;
+
+                case 0x07:
+                    //   VX = delay timer
+                    V[chip8->instruction.X] = chip8->timer1;
+                    break;
+
+                case 0x15:
+                    //  delay timer = VX
+                    chip8->timer1 = V[chip8->instruction.X];
+                    break;
+
+                case 0x18:
+                    //  audio timer = VX
+                    chip8->timer2 = V[chip8->instruction.X];
+                    break;
+
+                case 0x29:
+                    //  set I to sprite location for char in VX
+                    chip8->I = CHIP8_FONT_ADDR + V[chip8->instruction.X] * 5;
+                    break;
+
+
+                case 0x33:                                            // FX33: BCD
+                    CHIP8_CHECK_RAM(chip8, chip8->I, 3);
+                    chip8->ram[chip8->I] = V[chip8->instruction.X] / 100;
+                    chip8->ram[chip8->I + 1] = (V[chip8->instruction.X] / 10) % 10;
+                    chip8->ram[chip8->I + 2] = V[chip8->instruction.X] % 10;
+                    chip8_ram_written(chip8, chip8->I, 3);
+                    break;
+
+                case 0x55:                                             // FX55: Store V0..VX
+                    chip8_store(chip8, chip8->instruction.X, q);
+                    break;
+
+                case 0x65:                                             // FX65: Load V0..VX
+                    chip8_load_regs(chip8, chip8->instruction.X, q);
+                    break;
+
+                case 0x30:                                             // FX30: big digit VX
+                    if (q.schip) chip8->I = CHIP8_BIG_FONT_ADDR + (V[chip8->instruction.X] & 0xF) * 10;
+                    else CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+
+                case 0x75:                                             // FX75: V0..VX to flags
+                    if (q.schip) memcpy(chip8->flags, V, chip8->instruction.X + 1);
+                    else CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+
+                case 0x85:                                             // FX85: flags to V0..VX
+                    if (q.schip) memcpy(V, chip8->flags, chip8->instruction.X + 1);
+                    else CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+
+                case 0x00:                                             // F000 NNNN: I = NNNN
+                    if (q.xochip && chip8->instruction.X == 0) {
+                        chip8->I = ((chip8->ram[chip8->PC & (CHIP8_RAM_SIZE - 1)] << 8) |
+                                    chip8->ram[(chip8->PC + 1) & (CHIP8_RAM_SIZE - 1)]) & (CHIP8_RAM_SIZE - 1);
+                        chip8->PC += 2;
+                    } else {
+                        CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    }
+                    break;
+
+                default:
+                    CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+                    break;
+
+            }
+            break;
+
+
+            default:
+                CHIP8_TRAP_IF(chip8, true, CHIP8_FAULT_OPCODE);
+            break;
+        }
+    }
+}
+
+
+// one interpreter loop per variant
+#define RUN_VARIANT(name, id, ...) \
+    static void run_##name(chip8_t *chip8, uint32_t cycles) { \
+        while (cycles-- && !CHIP8_FAULTED(chip8)) step(chip8, CHIP8_QUIRKS(__VA_ARGS__)); \
+    }
+CHIP8_VARIANTS(RUN_VARIANT)
+
+// and one recording every instruction, only entered while a trace is attached
+#define RUN_TRACED(name, id, ...) \
+    static void run_traced_##name(chip8_t *chip8, uint32_t cycles) { \
+        while (cycles-- && !CHIP8_FAULTED(chip8)) { \
+            uint16_t pc = chip8->PC; \
+            step(chip8, CHIP8_QUIRKS(__VA_ARGS__)); \
+            if (!CHIP8_FAULTED(chip8)) chip8_trace_op(chip8->trace, chip8, pc); \
+        } \
+    }
+CHIP8_VARIANTS(RUN_TRACED)
+
+
+void compute_instruction(chip8_t *chip8) {
+    uint16_t pc = chip8->PC;
+
+    switch (chip8->variant) {
+#define STEP_VARIANT(name, id, ...) case id: step(chip8, CHIP8_QUIRKS(__VA_ARGS__)); break;
+        CHIP8_VARIANTS(STEP_VARIANT)
+        default: break;
+    }
+
+    if (chip8->trace && !CHIP8_FAULTED(chip8)) chip8_trace_op(chip8->trace, chip8, pc);
+}
+
+
+// the variant is picked once per call, not per instruction
+static void run_interp(chip8_t *chip8, uint32_t cycles) {
+    switch (chip8->variant) {
+#define RUN_CASE(name, id, ...) case id: run_##name(chip8, cycles); break;
+        CHIP8_VARIANTS(RUN_CASE)
+        default: break;
+    }
+}
+
+static void run_traced(chip8_t *chip8, uint32_t cycles) {
+    switch (chip8->variant) {
+#define TRACED_CASE(name, id, ...) case id: run_traced_##name(chip8, cycles); break;
+        CHIP8_VARIANTS(TRACED_CASE)
+        default: break;
+    }
+}
+
+
+const char *const chip8_fault_names[CHIP8_FAULT_COUNT] = {
+    [CHIP8_FAULT_NONE] = "none",
+    [CHIP8_FAULT_RAM] = "ram",
+    [CHIP8_FAULT_STACK_OVERFLOW] = "stack-overflow",
+    [CHIP8_FAULT_STACK_UNDERFLOW] = "stack-underflow",
+    [CHIP8_FAULT_OPCODE] = "opcode",
+    [CHIP8_FAULT_PC] = "pc",
+    [CHIP8_FAULT_KEY] = "key",
+};
+
+
+void chip8_trap(chip8_t *chip8, chip8_fault_t fault) {
+    const char *rom = chip8->rom_name ? chip8->rom_name : "rom";
+    chip8->fault = fault;
+
+    if (fault == CHIP8_FAULT_PC) {
+        CHIP8_LOG("%s: pc fault, PC=0x%04X past the end of ram, SP=%d", rom, chip8->PC, chip8->stack_pointer);
+        return;
+    }
+
+    chip8->PC -= 2;
+    uint16_t pc = chip8->PC & (CHIP8_RAM_SIZE - 1);
+    uint16_t opcode = (chip8->ram[pc] << 8) | chip8->ram[(pc + 1) & (CHIP8_RAM_SIZE - 1)];
+    CHIP8_LOG("%s: %s fault at PC=0x%03X opcode=0x%04X I=0x%04X SP=%d", rom, chip8_fault_names[fault],
+              pc, opcode, chip8->I, chip8->stack_pointer);
+}
+
+
+void chip8_seed(chip8_t *chip8, uint32_t seed) {
+    chip8->rng = seed ? seed : 0x9E3779B9;     // xorshift is stuck at 0
+}
+
+
+uint32_t chip8_run(chip8_t *chip8, uint32_t cycles) {
+    if (CHIP8_FAULTED(chip8)) return 0;
+
+    // an armed debugger checks every instruction, a stopped one runs none
+    if (chip8->debug && (chip8->debug->stop != CHIP8_STOP_NONE || chip8_debug_armed(chip8->debug)))
+        return chip8_debug_run(chip8, cycles);
+
+    // traced runs take the interpreter and no shortcuts, so every instruction is recorded
+    if (chip8->trace) {
+        run_traced(chip8, cycles);
+        return cycles;
+    }
+
+    // skipped passes count as run, they leave the machine as running them would.
+    // not while profiling: the opcode counters would miss exactly the wait loops
+    uint32_t skipped = chip8->skip_idle && !chip8->prof ? chip8_idle_skip(chip8, cycles) : 0;
+    uint32_t left = cycles - skipped;
+    chip8->idle_skipped += skipped;
+
+    if (chip8->blocks) chip8_run_blocks(chip8, left);
+    else if (chip8->cache) chip8_run_cached(chip8, left);
+    else run_interp(chip8, left);
+    return cycles;
+}
+
+
+void chip8_ram_written(chip8_t *chip8, uint16_t addr, uint16_t len) {
+    if (chip8->cache)
+        chip8_cache_invalidate(chip8->cache, addr, len);
+    if (chip8->blocks)
+        chip8_blocks_invalidate(chip8->blocks, addr, len);
+}
+
+
+// 60Hz delay/sound timer tick
+void chip8_tick_timers(chip8_t *chip8) {
+    if (chip8->timer1 > 0) chip8->timer1--;
+    if (chip8->timer2 > 0) chip8->timer2--;
+}
+
+
+void chip8_run_frame(chip8_t *chip8) {
+    chip8_tick_timers(chip8);
+    chip8_run(chip8, CHIP8_CYCLES_PER_FRAME);
+}
+
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+
+uint64_t chip8_hash(const chip8_t *chip8) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    hash = fnv1a(hash, chip8->ram, sizeof chip8->ram);
+    hash = fnv1a(hash, chip8->display, sizeof chip8->display);
+    hash = fnv1a(hash, chip8->stack, sizeof chip8->stack);
+    hash = fnv1a(hash, &chip8->stack_pointer, sizeof chip8->stack_pointer);
+    hash = fnv1a(hash, chip8->V_reg, sizeof chip8->V_reg);
+    hash = fnv1a(hash, &chip8->I, sizeof chip8->I);
+    hash = fnv1a(hash, &chip8->timer1, sizeof chip8->timer1);
+    hash = fnv1a(hash, &chip8->timer2, sizeof chip8->timer2);
+    hash = fnv1a(hash, &chip8->PC, sizeof chip8->PC);
+
+    // default machines hash as they always did
+    if (chip8_quirks[chip8->variant].schip) {
+        hash = fnv1a(hash, &chip8->hires, sizeof chip8->hires);
+        hash = fnv1a(hash, chip8->hires_display, sizeof chip8->hires_display);
+        hash = fnv1a(hash, chip8->flags, sizeof chip8->flags);
+    }
+    return hash;
+}
+
+
+void chip8_dump(const chip8_t *chip8, FILE *out) {
+    fprintf(out, "PC=0x%03X I=0x%03X SP=%d DT=%d ST=%d\n", chip8->PC, chip8->I,
+            chip8->stack_pointer, chip8->timer1, chip8->timer2);
+    if (chip8->fault != CHIP8_FAULT_NONE)
+        fprintf(out, "fault: %s\n", chip8_fault_names[chip8->fault]);
+
+    for (int i = 0; i < 16; i++)
+        fprintf(out, "V%X=%02X%c", i, chip8->V_reg[i], i == 15 ? '\n' : ' ');
+
+    if (chip8->hires) {
+        for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            for (int x = 0; x < CHIP8_HIRES_WIDTH; x++)
+                fputc((chip8->hires_display[y][x / 64] >> (63 - x % 64)) & 1 ? '#' : '.', out);
+            fputc('\n', out);
+        }
+        return;
+    }
+
+    for (int y = 0; y < CHIP8_HEIGHT; y++) {
+        for (int x = 0; x < CHIP8_WIDTH; x++)
+            fputc(chip8_pixel(chip8, x, y) ? '#' : '.', out);
+        fputc('\n', out);
+    }
+}
@@ -0,0 +1,204 @@
+#ifndef CHIP8_CORE_H
+#define CHIP8_CORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* emulator core - no SDL in here, so it can be used headless
+ * (batch runs, tools) as well as by the SDL frontend in chip8.c
+ */
+
+
+// original CHIP8 display 64x32
+#define CHIP8_WIDTH 64
+#define CHIP8_HEIGHT 32
+
+// SCHIP / XO-CHIP high resolution plane 128x64
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+
+#define CHIP8_RAM_SIZE 4096
+#define CHIP8_FONT_ADDR 0x050
+#define CHIP8_BIG_FONT_ADDR 0x0A0  // SCHIP 8x10 digits, loaded by chip8_set_variant
+#define CHIP8_ROM_ADDR 0x200   // chip8 roms load to 0x200
+
+#define CHIP8_CYCLES_PER_FRAME 8   // instructions run per 60Hz frame
+#define CHIP8_STACK_DEPTH 12
+
+
+// core log, goes to stderr
+#define CHIP8_LOG(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+// opcode/address counters for chip8_prof.h, compiled out unless -DCHIP8_PROFILE
+#ifdef CHIP8_PROFILE
+#define CHIP8_PROF_OP(chip8, pc, opcode) do { if ((chip8)->prof) chip8_prof_op((chip8)->prof, pc, opcode); } while (0)
+#else
+#define CHIP8_PROF_OP(chip8, pc, opcode) ((void)0)
+#endif
+
+// access policy, picked at build time. -DCHIP8_CHECKED traps ram accesses past
+// the end of ram, stack overflow/underflow, PC running off ram, EX9E/EXA1 on a
+// key past F and opcodes the variant doesn't have: the fault is logged with the PC, left on the faulting
+// instruction, and the machine stops (chip8->fault) until reloaded or restored.
+// the default unchecked build compiles the checks and the per-opcode logs out,
+// a rom doing any of the above is undefined behaviour there (key numbers are
+// masked to 0-F, so those at least stay in bounds)
+#ifdef CHIP8_CHECKED
+#define CHIP8_TRAP_IF(chip8, cond, fault) \
+    do { if (__builtin_expect(!!(cond), 0)) { chip8_trap(chip8, fault); return; } } while (0)
+#define CHIP8_FAULTED(chip8) ((chip8)->fault != CHIP8_FAULT_NONE)
+#define CHIP8_OP_LOG(...) CHIP8_LOG(__VA_ARGS__)
+#else
+#define CHIP8_TRAP_IF(chip8, cond, fault) ((void)0)
+#define CHIP8_FAULTED(chip8) false
+#define CHIP8_OP_LOG(...) ((void)0)
+#endif
+
+// ram[addr .. addr + len - 1] must lie in ram
+#define CHIP8_CHECK_RAM(chip8, addr, len) \
+    CHIP8_TRAP_IF(chip8, (unsigned)(addr) + (len) > CHIP8_RAM_SIZE, CHIP8_FAULT_RAM)
+
+
+//states
+typedef enum{
+    QUIT,
+    RUNNING,
+    PAUSE,
+}emulator_state_t;
+
+// instruction set and quirk profile, see chip8_variant.h
+typedef enum {
+    CHIP8_VARIANT_DEFAULT,
+    CHIP8_VARIANT_COSMAC,
+    CHIP8_VARIANT_SCHIP,
+    CHIP8_VARIANT_XOCHIP,
+    CHIP8_VARIANT_COUNT,
+}chip8_variant_t;
+
+typedef enum {
+    CHIP8_FAULT_NONE,
+    CHIP8_FAULT_RAM,
+    CHIP8_FAULT_STACK_OVERFLOW,
+    CHIP8_FAULT_STACK_UNDERFLOW,
+    CHIP8_FAULT_OPCODE,     // not in the variant's instruction set
+    CHIP8_FAULT_PC,         // fetch past the end of ram
+    CHIP8_FAULT_KEY,        // EX9E/EXA1 with VX past key F
+    CHIP8_FAULT_COUNT,
+}chip8_fault_t;
+
+typedef struct {
+    uint16_t opcode;
+    uint16_t NNN;   // constants
+    uint8_t NN;
+    uint8_t N;
+    uint8_t X;  //identifiers
+    uint8_t Y;
+}instruction_t;
+
+typedef struct chip8_cache chip8_cache_t;   // chip8_cache.h
+typedef struct chip8_blocks chip8_blocks_t; // chip8_block.h
+typedef struct chip8_prof chip8_prof_t;     // chip8_prof.h
+typedef struct chip8_trace chip8_trace_t;   // chip8_trace.h
+typedef struct chip8_debug chip8_debug_t;   // chip8_debug.h
+
+//chip8 machine
+typedef struct{
+    emulator_state_t state;
+    uint8_t ram[CHIP8_RAM_SIZE];  //byte
+    uint64_t display[CHIP8_HEIGHT]; // 64*32 -- one row per word, bit 63 = x 0
+    uint32_t dirty_rows;    // bit per display row (hires: row pair) changed since the last render
+    uint16_t stack[CHIP8_STACK_DEPTH]; //word
+    uint8_t stack_pointer;  // index of the next free stack slot
+    uint8_t V_reg[16];  // registers V0 - VF
+    uint16_t I;         // index reg
+    bool keyboard[16];
+    uint8_t timer1;     // video timer
+    uint8_t timer2;     // audio timer
+    uint16_t PC;        //program counter
+    uint32_t rng;       // CXNN xorshift state, never 0
+    char* rom_name;
+    instruction_t  instruction; //current instr
+    chip8_cache_t *cache;       // decoded ops, NULL = run compute_instruction
+    chip8_blocks_t *blocks;     // translated blocks, used over cache when attached
+    chip8_prof_t *prof;         // opcode counters, NULL = off
+    chip8_trace_t *trace;       // execution trace, NULL = off
+    chip8_debug_t *debug;       // breakpoints/watchpoints, NULL = off
+    bool skip_idle;             // fast-forward wait loops (chip8_idle.h), on by default
+    uint32_t idle_holdoff;      // instructions to run before the next idle check
+    uint64_t idle_skipped;      // instructions fast-forwarded so far, counted as run
+    chip8_variant_t variant;    // set with chip8_set_variant (chip8_variant.h)
+    bool hires;                 // SCHIP 128x64 mode, draws go to hires_display
+    uint64_t hires_display[CHIP8_HIRES_HEIGHT][2];  // bit 63 of [0] = x 0, of [1] = x 64
+    uint8_t flags[16];          // SCHIP FX75/FX85 user flags
+    chip8_fault_t fault;        // checked builds: set by chip8_trap, stops the machine
+}chip8_t;
+
+extern const char *const chip8_fault_names[CHIP8_FAULT_COUNT];
+
+
+
+// pixel at x, y of the packed display
+static inline bool chip8_pixel(const chip8_t *chip8, int x, int y) {
+    return (chip8->display[y] >> (63 - x)) & 1;
+}
+
+// xorshift32 step, returns the top byte
+static inline uint8_t chip8_xorshift(uint32_t *state) {
+    uint32_t r = *state;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    *state = r;
+    return r >> 24;
+}
+
+// CXNN random byte, per machine so runs are reproducible and thread safe
+static inline uint8_t chip8_rand(chip8_t *chip8) {
+    return chip8_xorshift(&chip8->rng);
+}
+
+// sprite byte placed at column x of a display row, wrapping past the right edge
+static inline uint64_t chip8_sprite_row(uint8_t sprite, uint8_t x) {
+    uint64_t bits = (uint64_t)sprite << 56;
+    return x ? (bits >> x) | (bits << (64 - x)) : bits;
+}
+
+
+// load font + rom and set defaults
+bool init_chip(chip8_t *chip8, char rom_name[]);
+
+// same as init_chip for a rom image already in memory
+bool chip8_load(chip8_t *chip8, const uint8_t *rom, size_t rom_size);
+
+// fetch, decode and execute one instruction
+void compute_instruction(chip8_t *chip8);
+
+// record a fault and log it with the PC context. PC is past the faulting
+// instruction (at it for CHIP8_FAULT_PC) and is moved back onto it
+void chip8_trap(chip8_t *chip8, chip8_fault_t fault);
+
+// seed the CXNN generator
+void chip8_seed(chip8_t *chip8, uint32_t seed);
+
+// run cycles instructions on the attached blocks or cache, or the interpreter without either.
+// returns how many ran, fewer when a debugger stop ends the run early
+uint32_t chip8_run(chip8_t *chip8, uint32_t cycles);
+
+// ram[addr .. addr + len - 1] was written, drop stale decoded ops
+void chip8_ram_written(chip8_t *chip8, uint16_t addr, uint16_t len);
+
+// 60Hz delay/sound timer tick
+void chip8_tick_timers(chip8_t *chip8);
+
+// one 60Hz frame: timers + CHIP8_CYCLES_PER_FRAME instructions
+void chip8_run_frame(chip8_t *chip8);
+
+// FNV-1a hash of the machine state (ram, display, registers, stack, timers)
+uint64_t chip8_hash(const chip8_t *chip8);
+
+// print registers, fault and display (headless runs)
+void chip8_dump(const chip8_t *chip8, FILE *out);
+
+#endif // CHIP8_CORE_H
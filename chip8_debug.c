@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_debug.h"
+#include "chip8_variant.h"
+
+
+#define BIT(map, addr) ((map)[(addr) / 64] & (1ull << ((addr) % 64)))
+
+
+static const char *const stop_names[] = {
+    [CHIP8_STOP_NONE] = "running",
+    [CHIP8_STOP_BREAK] = "breakpoint",
+    [CHIP8_STOP_WATCH] = "watchpoint",
+    [CHIP8_STOP_STEP] = "step",
+};
+
+
+void chip8_debug_init(chip8_debug_t *debug) {
+    memset(debug, 0, sizeof *debug);
+    debug->over_sp = -1;
+    debug->store = -1;
+}
+
+
+// flip addr in map if it isn't on already, returns the change in set bits
+static int set_bit(uint64_t *map, uint16_t addr, bool on) {
+    uint64_t bit = 1ull << (addr % 64);
+    bool was = map[addr / 64] & bit;
+
+    if (on) map[addr / 64] |= bit;
+    else map[addr / 64] &= ~bit;
+    return on - was;
+}
+
+
+void chip8_debug_break(chip8_debug_t *debug, uint16_t addr, bool on) {
+    debug->breakpoints += set_bit(debug->breaks, addr & (CHIP8_RAM_SIZE - 1), on);
+}
+
+
+void chip8_debug_watch(chip8_debug_t *debug, uint16_t addr, uint16_t len, bool on) {
+    for (uint16_t i = 0; i < len; i++)
+        debug->watchpoints += set_bit(debug->watches, (addr + i) & (CHIP8_RAM_SIZE - 1), on);
+}
+
+
+void chip8_debug_continue(chip8_debug_t *debug) {
+    debug->stop = CHIP8_STOP_NONE;
+    debug->resume = true;
+    debug->steps = 0;
+    debug->over_sp = -1;
+}
+
+
+void chip8_debug_step(chip8_debug_t *debug, uint32_t count) {
+    chip8_debug_continue(debug);
+    debug->steps = count;
+}
+
+
+void chip8_debug_step_over(chip8_debug_t *debug, const chip8_t *chip8) {
+    uint16_t pc = chip8->PC & (CHIP8_RAM_SIZE - 1);
+
+    if (chip8->ram[pc] >> 4 != 0x2) {
+        chip8_debug_step(debug, 1);
+        return;
+    }
+
+    chip8_debug_continue(debug);
+    debug->over_pc = chip8->PC + 2;
+    debug->over_sp = chip8->stack_pointer;
+}
+
+
+static void halt(chip8_debug_t *debug, chip8_stop_t why) {
+    debug->stop = why;
+    debug->steps = 0;
+    debug->over_sp = -1;
+}
+
+
+// ram bytes the instruction at pc stores to, 0 for anything but a store
+static uint16_t store_range(const chip8_t *chip8, uint16_t pc, uint16_t *addr) {
+    uint8_t hi = chip8->ram[pc];
+    uint8_t lo = chip8->ram[(pc + 1) & (CHIP8_RAM_SIZE - 1)];
+    uint8_t X = hi & 0xF;
+    uint8_t Y = lo >> 4;
+
+    *addr = chip8->I;
+    if (hi >> 4 == 0xF && lo == 0x33) return 3;                     // FX33
+    if (hi >> 4 == 0xF && lo == 0x55) return X + 1;                 // FX55
+    if (hi >> 4 == 0x5 && (lo & 0xF) == 2 && chip8_quirks[chip8->variant].xochip)
+        return (X > Y ? X - Y : Y - X) + 1;                         // 5XY2
+    return 0;
+}
+
+
+// stop before the instruction at PC? also notes a watched byte it is about to store to
+static bool before(chip8_debug_t *debug, const chip8_t *chip8) {
+    uint16_t pc = chip8->PC & (CHIP8_RAM_SIZE - 1);
+    bool resume = debug->resume;
+    debug->resume = false;
+
+    if (!resume && BIT(debug->breaks, pc)) {
+        halt(debug, CHIP8_STOP_BREAK);
+        return true;
+    }
+
+    if (debug->over_sp >= 0 && chip8->PC == debug->over_pc && chip8->stack_pointer == debug->over_sp) {
+        halt(debug, CHIP8_STOP_STEP);
+        return true;
+    }
+
+    debug->store = -1;
+    if (debug->watchpoints) {
+        uint16_t addr;
+        uint16_t len = store_range(chip8, pc, &addr);
+
+        for (uint16_t i = 0; i < len; i++) {
+            uint16_t a = (addr + i) & (CHIP8_RAM_SIZE - 1);
+            if (BIT(debug->watches, a)) {
+                debug->store = a;
+                debug->watch_old = chip8->ram[a];
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+
+static void after(chip8_debug_t *debug, const chip8_t *chip8, uint16_t pc) {
+    if (debug->store >= 0) {
+        debug->watch_addr = debug->store;
+        debug->watch_pc = pc;
+        debug->watch_new = chip8->ram[debug->store];
+        halt(debug, CHIP8_STOP_WATCH);
+        return;
+    }
+
+    if (debug->steps && --debug->steps == 0)
+        halt(debug, CHIP8_STOP_STEP);
+}
+
+
+uint32_t chip8_debug_run(chip8_t *chip8, uint32_t cycles) {
+    chip8_debug_t *debug = chip8->debug;
+    uint32_t ran = 0;
+
+    for (; ran < cycles && debug->stop == CHIP8_STOP_NONE && !CHIP8_FAULTED(chip8); ran++) {
+        uint16_t pc = chip8->PC;
+        if (before(debug, chip8)) break;
+
+        compute_instruction(chip8);
+        if (CHIP8_FAULTED(chip8)) break;
+
+        after(debug, chip8, pc);
+    }
+    return ran;
+}
+
+
+void chip8_debug_print_state(const chip8_t *chip8, FILE *out) {
+    const chip8_debug_t *debug = chip8->debug;
+    uint16_t pc = chip8->PC & (CHIP8_RAM_SIZE - 1);
+
+    if (debug && debug->stop == CHIP8_STOP_WATCH)
+        fprintf(out, "watchpoint: 0x%03X %02X -> %02X, written at 0x%03X\n", debug->watch_addr,
+                debug->watch_old, debug->watch_new, debug->watch_pc);
+    else if (debug)
+        fprintf(out, "%s\n", stop_names[debug->stop]);
+
+    fprintf(out, "PC=0x%03X op=%02X%02X I=0x%03X SP=%d DT=%d ST=%d\n", chip8->PC, chip8->ram[pc],
+            chip8->ram[(pc + 1) & (CHIP8_RAM_SIZE - 1)], chip8->I, chip8->stack_pointer,
+            chip8->timer1, chip8->timer2);
+
+    for (int i = 0; i < 16; i++)
+        fprintf(out, "V%X=%02X%c", i, chip8->V_reg[i], i == 15 ? '\n' : ' ');
+
+    fprintf(out, "stack:");
+    for (int i = (chip8->stack_pointer < CHIP8_STACK_DEPTH ? chip8->stack_pointer : CHIP8_STACK_DEPTH) - 1; i >= 0; i--)
+        fprintf(out, " 0x%03X", chip8->stack[i]);
+    fputc('\n', out);
+}
+
+
+void chip8_debug_print_ram(const chip8_t *chip8, uint16_t addr, uint16_t len, FILE *out) {
+    for (uint16_t row = 0; row < len; row += 16) {
+        fprintf(out, "%03X:", (addr + row) & (CHIP8_RAM_SIZE - 1));
+        for (uint16_t i = row; i < row + 16 && i < len; i++)
+            fprintf(out, " %02X", chip8->ram[(addr + i) & (CHIP8_RAM_SIZE - 1)]);
+        fputc('\n', out);
+    }
+}
+
+
+chip8_debug_action_t chip8_debug_command(chip8_t *chip8, const char *line, FILE *out) {
+    chip8_debug_t *debug = chip8->debug;
+    char cmd[8] = "s";
+    char a[16], b[16];
+    int args = sscanf(line, "%7s %15s %15s", cmd, a, b) - 1;
+
+    unsigned long addr = args >= 1 ? strtoul(a, NULL, 16) : chip8->I;
+    unsigned long len = args >= 2 ? strtoul(b, NULL, 0) : 1;
+
+    if (strcmp(cmd, "b") == 0 || strcmp(cmd, "d") == 0) {
+        if (args < 1) goto usage;
+        chip8_debug_break(debug, addr, cmd[0] == 'b');
+        fprintf(out, "%d breakpoints\n", debug->breakpoints);
+    } else if (strcmp(cmd, "w") == 0 || strcmp(cmd, "uw") == 0) {
+        if (args < 1) goto usage;
+        chip8_debug_watch(debug, addr, len, cmd[0] == 'w');
+        fprintf(out, "%d watched bytes\n", debug->watchpoints);
+    } else if (strcmp(cmd, "s") == 0) {
+        unsigned long count = args >= 1 ? strtoul(a, NULL, 10) : 1;
+        chip8_debug_step(debug, count ? count : 1);
+        return CHIP8_DEBUG_RUN;
+    } else if (strcmp(cmd, "n") == 0) {
+        chip8_debug_step_over(debug, chip8);
+        return CHIP8_DEBUG_RUN;
+    } else if (strcmp(cmd, "c") == 0) {
+        chip8_debug_continue(debug);
+        return CHIP8_DEBUG_RUN;
+    } else if (strcmp(cmd, "r") == 0) {
+        chip8_debug_print_state(chip8, out);
+    } else if (strcmp(cmd, "m") == 0) {
+        chip8_debug_print_ram(chip8, addr, args >= 2 ? len : 64, out);
+    } else if (strcmp(cmd, "q") == 0) {
+        return CHIP8_DEBUG_QUIT;
+    } else {
+        goto usage;
+    }
+    return CHIP8_DEBUG_STAY;
+
+usage:
+    fprintf(out, "b/d ADDR        set/delete a breakpoint\n"
+                 "w/uw ADDR [LEN] watch/unwatch LEN bytes for writes\n"
+                 "s [N]           step N instructions, an empty line steps one\n"
+                 "n               step over a CALL\n"
+                 "c               continue\n"
+                 "r               registers and stack\n"
+                 "m [ADDR [LEN]]  dump ram, at I by default\n"
+                 "q               quit\n");
+    return CHIP8_DEBUG_STAY;
+}
@@ -0,0 +1,88 @@
+#ifndef CHIP8_DEBUG_H
+#define CHIP8_DEBUG_H
+
+#include "chip8_core.h"
+
+
+/* debugger
+ * PC breakpoints and ram write watchpoints are bitmaps over ram. while none
+ * are set and no step is pending chip8_run takes the usual cores and pays
+ * one test per call; once something is armed it swaps in an interpreter loop
+ * that checks the breakpoint bit before each instruction and the watched
+ * bytes of FX33/FX55/5XY2 stores. a stop leaves the machine halted (timers
+ * too) until continued or stepped; a stop on a breakpoint is before the
+ * instruction, one on a watchpoint after the store.
+ */
+
+typedef enum {
+    CHIP8_DEBUG_STAY,   // inspected or changed something, prompt again
+    CHIP8_DEBUG_RUN,    // stepping or continuing, run the machine
+    CHIP8_DEBUG_QUIT,
+}chip8_debug_action_t;
+
+typedef enum {
+    CHIP8_STOP_NONE,
+    CHIP8_STOP_BREAK,   // PC hit a breakpoint
+    CHIP8_STOP_WATCH,   // a store touched a watched byte
+    CHIP8_STOP_STEP,    // step / step over done
+}chip8_stop_t;
+
+struct chip8_debug {
+    uint64_t breaks[CHIP8_RAM_SIZE / 64];
+    uint64_t watches[CHIP8_RAM_SIZE / 64];
+    int breakpoints;    // bits set in breaks
+    int watchpoints;    // bits set in watches
+    uint32_t steps;     // instructions left to step, 0 = not stepping
+    int over_sp;        // step over: stop back at over_pc with this stack depth, -1 = off
+    uint16_t over_pc;
+    bool resume;        // don't stop on the breakpoint at PC before it has run
+    int store;          // watched byte the running instruction stores to, -1 = none
+    chip8_stop_t stop;
+    uint16_t watch_addr;            // CHIP8_STOP_WATCH: first watched byte written,
+    uint16_t watch_pc;              // by the instruction here,
+    uint8_t watch_old, watch_new;   // from and to
+};
+
+
+void chip8_debug_init(chip8_debug_t *debug);
+
+// set or clear a PC breakpoint
+void chip8_debug_break(chip8_debug_t *debug, uint16_t addr, bool on);
+
+// set or clear write watchpoints on ram[addr .. addr + len - 1]
+void chip8_debug_watch(chip8_debug_t *debug, uint16_t addr, uint16_t len, bool on);
+
+// leave a stop and run on, past a breakpoint at PC
+void chip8_debug_continue(chip8_debug_t *debug);
+
+// run count instructions then stop, from running or stopped
+void chip8_debug_step(chip8_debug_t *debug, uint32_t count);
+
+// step, but run a CALL at PC until it returns
+void chip8_debug_step_over(chip8_debug_t *debug, const chip8_t *chip8);
+
+// chip8_run's loop while armed or stopped: up to cycles instructions, none when stopped.
+// returns how many ran
+uint32_t chip8_debug_run(chip8_t *chip8, uint32_t cycles);
+
+// why the machine stopped, registers, stack and the next opcode
+void chip8_debug_print_state(const chip8_t *chip8, FILE *out);
+
+// hex dump of ram[addr .. addr + len - 1], 16 bytes a row
+void chip8_debug_print_ram(const chip8_t *chip8, uint16_t addr, uint16_t len, FILE *out);
+
+// one prompt line: b/d ADDR, w/uw ADDR [LEN], s [N], n, c, r, m [ADDR [LEN]], q, h.
+// addresses are hex, an empty line steps
+chip8_debug_action_t chip8_debug_command(chip8_t *chip8, const char *line, FILE *out);
+
+
+// anything that needs the checking loop
+static inline bool chip8_debug_armed(const chip8_debug_t *debug) {
+    return debug->breakpoints || debug->watchpoints || debug->steps || debug->over_sp >= 0;
+}
+
+static inline bool chip8_debug_stopped(const chip8_t *chip8) {
+    return chip8->debug && chip8->debug->stop != CHIP8_STOP_NONE;
+}
+
+#endif // CHIP8_DEBUG_H
@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include "chip8_idle.h"
+#include "chip8_variant.h"
+
+
+typedef struct {
+    uint8_t V[16];
+    uint16_t I;
+    uint16_t PC;
+}idle_regs_t;
+
+
+static bool any_key(const chip8_t *chip8) {
+    for (int i = 0; i < 16; i++)
+        if (chip8->keyboard[i]) return true;
+    return false;
+}
+
+
+// one pass from r->PC back to it, at most limit instructions, through opcodes
+// that only touch V, I and PC; same semantics as compute_instruction. returns
+// instructions taken, 0 when anything else comes up or PC doesn't come back. none of these ops differ
+// between variants except that XO-CHIP skips may step over F000 NNNN, so a
+// loop skipping onto one is left to the core
+static uint32_t pass(const chip8_t *chip8, idle_regs_t *r, uint32_t limit) {
+    const uint16_t start = r->PC;
+    const bool xochip = chip8_quirks[chip8->variant].xochip;
+    uint8_t *V = r->V;
+
+    for (uint32_t steps = 1; steps <= limit; steps++) {
+        if (r->PC > CHIP8_RAM_SIZE - 2) return 0;
+
+        uint16_t opcode = (chip8->ram[r->PC] << 8) | chip8->ram[r->PC + 1];
+        uint16_t NNN = opcode & 0x0FFF;
+        uint8_t NN = opcode & 0x00FF;
+        uint8_t N = opcode & 0x000F;
+        uint8_t X = (opcode >> 8) & 0x000F;
+        uint8_t Y = (opcode >> 4) & 0x000F;
+
+        r->PC += 2;
+
+        if (xochip && r->PC <= CHIP8_RAM_SIZE - 2 && chip8->ram[r->PC] == 0xF0 && chip8->ram[r->PC + 1] == 0x00)
+            return 0;
+
+        switch (opcode >> 12) {
+            case 0x1: r->PC = NNN; break;
+            case 0x3: if (V[X] == NN) r->PC += 2; break;
+            case 0x4: if (V[X] != NN) r->PC += 2; break;
+            case 0x5:
+                if (N != 0) return 0;   // 5XY2/5XY3 on XO-CHIP
+                if (V[X] == V[Y]) r->PC += 2;
+                break;
+            case 0x6: V[X] = NN; break;
+            case 0x9: if (N == 0 && V[X] != V[Y]) r->PC += 2; break;
+            case 0xA: r->I = NNN; break;
+
+            case 0x8:
+                if (N != 0) return 0;
+                V[X] = V[Y];
+                break;
+
+            case 0xE:
+                if (V[X] > 15) return 0;
+                if (NN == 0x9E) { if (chip8->keyboard[V[X]]) r->PC += 2; }
+                else if (NN == 0xA1) { if (!chip8->keyboard[V[X]]) r->PC += 2; }
+                else return 0;
+                break;
+
+            case 0xF:
+                if (NN == 0x07) V[X] = chip8->timer1;
+                else if (NN == 0x0A && !any_key(chip8)) r->PC -= 2;
+                else return 0;
+                break;
+
+            default:
+                return 0;
+        }
+
+        if (r->PC == start) return steps;
+    }
+
+    return 0;
+}
+
+
+uint32_t chip8_idle_skip(chip8_t *chip8, uint32_t cycles) {
+    idle_regs_t first, second;
+
+    if (chip8->idle_holdoff > 0) {
+        chip8->idle_holdoff -= chip8->idle_holdoff < cycles ? chip8->idle_holdoff : cycles;
+        return 0;
+    }
+
+    memset(&first, 0, sizeof first);
+    memcpy(first.V, chip8->V_reg, sizeof first.V);
+    first.I = chip8->I;
+    first.PC = chip8->PC;
+
+    uint32_t settle = pass(chip8, &first, CHIP8_IDLE_MAX_LOOP);
+    second = first;
+    uint32_t len = settle && settle <= cycles ? pass(chip8, &second, CHIP8_IDLE_MAX_LOOP) : 0;
+    if (len == 0 || memcmp(&first, &second, sizeof first) != 0) {
+        chip8->idle_holdoff = CHIP8_IDLE_HOLDOFF;
+        return 0;
+    }
+
+    // first is reached after settle cycles and then repeats every len; the
+    // leftover steps retrace part of the pass just checked, so they can't bail
+    pass(chip8, &first, (cycles - settle) % len);
+    memcpy(chip8->V_reg, first.V, sizeof first.V);
+    chip8->I = first.I;
+    chip8->PC = first.PC;
+
+    return cycles;
+}
@@ -0,0 +1,28 @@
+#ifndef CHIP8_IDLE_H
+#define CHIP8_IDLE_H
+
+#include "chip8_core.h"
+
+
+/* idle-loop fast-forward
+ * timers and keys only change between chip8_run calls, so a loop built only
+ * from side-effect free opcodes (FX07, skips, jumps, loads of constants,
+ * FX0A with no key down) settles into a fixed point after one pass: every
+ * further pass leaves the machine exactly as it was. chip8_run evaluates up
+ * to two passes on a scratch copy of the registers and, when the second
+ * changes nothing, jumps to the fixed point, drops the whole passes that
+ * fit in the slice and steps the leftover partial pass on the scratch copy
+ * too, so an idle slice runs no instructions at all and the result is
+ * bit-identical to running every one. a frame's slice is only 8 instructions
+ * at the default 480Hz, too short to pay for a failed check each time, so
+ * after one the next waits until CHIP8_IDLE_HOLDOFF instructions have run;
+ * after a match the next slice is checked straight away.
+ */
+
+#define CHIP8_IDLE_MAX_LOOP 32      // longest loop looked at, in instructions
+#define CHIP8_IDLE_HOLDOFF 32       // instructions run after a failed check before the next
+
+// fast-forward an idle loop at PC, returns cycles consumed (0 = not idle)
+uint32_t chip8_idle_skip(chip8_t *chip8, uint32_t cycles);
+
+#endif // CHIP8_IDLE_H
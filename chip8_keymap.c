@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8_keymap.h"
+
+
+static const struct {
+    SDL_Scancode scancode;
+    int8_t key;
+} defaults[16] = {
+    { SDL_SCANCODE_1, 0x1 }, { SDL_SCANCODE_2, 0x2 }, { SDL_SCANCODE_3, 0x3 }, { SDL_SCANCODE_4, 0xC },
+    { SDL_SCANCODE_Q, 0x4 }, { SDL_SCANCODE_W, 0x5 }, { SDL_SCANCODE_E, 0x6 }, { SDL_SCANCODE_R, 0xD },
+    { SDL_SCANCODE_A, 0x7 }, { SDL_SCANCODE_S, 0x8 }, { SDL_SCANCODE_D, 0x9 }, { SDL_SCANCODE_F, 0xE },
+    { SDL_SCANCODE_Z, 0xA }, { SDL_SCANCODE_X, 0x0 }, { SDL_SCANCODE_C, 0xB }, { SDL_SCANCODE_V, 0xF },
+};
+
+
+void keymap_default(keymap_t *keymap) {
+    memset(keymap->keys, KEYMAP_NONE, sizeof keymap->keys);
+    for (int i = 0; i < 16; i++)
+        keymap->keys[defaults[i].scancode] = defaults[i].key;
+}
+
+
+bool keymap_load(keymap_t *keymap, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Keymap %s not found", path);
+        return false;
+    }
+
+    keymap_t loaded;
+    memset(loaded.keys, KEYMAP_NONE, sizeof loaded.keys);
+
+    char line[256];
+    int number = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof line, file)) {
+        unsigned key;
+        char name[64];
+        number++;
+
+        int fields = sscanf(line, "%x %63[^\r\n]", &key, name);
+        if (fields <= 0 || line[strspn(line, " \t")] == '#') continue;
+
+        SDL_Scancode scancode = fields == 2 ? SDL_GetScancodeFromName(name) : SDL_SCANCODE_UNKNOWN;
+        if (key > 0xF || scancode == SDL_SCANCODE_UNKNOWN) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Keymap %s line %d: expected <key 0-F> <scancode name>", path, number);
+            ok = false;
+        } else {
+            loaded.keys[scancode] = key;
+        }
+    }
+
+    fclose(file);
+    if (ok) *keymap = loaded;
+    return ok;
+}
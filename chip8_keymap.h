@@ -0,0 +1,34 @@
+#ifndef CHIP8_KEYMAP_H
+#define CHIP8_KEYMAP_H
+
+#include <SDL3/SDL.h>
+
+
+/* keymap
+ * scancode -> CHIP8 key lookup table. scancodes are physical positions, so
+ * the default 4x4 block stays under the same fingers on any layout:
+ * 123C     1234
+ * 456D     QWER
+ * 789E     ASDF
+ * A0BF     ZXCV
+ * a keymap file replaces it, one "<hex CHIP8 key> <SDL scancode name>" per
+ * line, # comments.
+ */
+
+#define KEYMAP_NONE -1
+
+typedef struct {
+    int8_t keys[SDL_SCANCODE_COUNT];    // CHIP8 key or KEYMAP_NONE
+}keymap_t;
+
+
+void keymap_default(keymap_t *keymap);
+
+// false (and keymap untouched) on an unreadable file or bad line
+bool keymap_load(keymap_t *keymap, const char *path);
+
+static inline int keymap_lookup(const keymap_t *keymap, SDL_Scancode scancode) {
+    return (unsigned)scancode < SDL_SCANCODE_COUNT ? keymap->keys[scancode] : KEYMAP_NONE;
+}
+
+#endif // CHIP8_KEYMAP_H
@@ -0,0 +1,325 @@
+#include <string.h>
+
+#include "chip8_lanes.h"
+
+
+#define RAM_MASK (CHIP8_RAM_SIZE - 1)
+
+// every lane; masked ops are written branch free so the loops vectorize
+#define EACH_LANE for (int l = 0; l < CHIP8_LANES; l++)
+
+// m ? b : a for 0x00/0xFF masks
+#define BLEND(a, b, m) (((a) & ~(m)) | ((b) & (m)))
+
+// the same for 16 bit a and b, the mask widened to 0x0000/0xFFFF
+#define BLEND16(a, b, m) BLEND(a, b, (uint16_t)(int8_t)(m))
+
+
+// PC past the next op where take[l] is 2. the skip ops compute take in a lane
+// array of their own: stored straight into PC the loops would not
+// vectorize, a byte read through VX may alias it
+static void skip(chip8_lanes_t *s, const uint8_t *take) {
+    EACH_LANE s->PC[l] += take[l];
+}
+
+
+// one opcode on every lane with m[l] = 0xFF, same semantics as compute_instruction
+static void step(chip8_lanes_t *s, const uint8_t *m, uint16_t opcode) {
+    uint16_t NNN = opcode & 0x0FFF;
+    uint8_t NN = opcode & 0x00FF;
+    uint8_t N = opcode & 0x000F;
+    uint8_t X = (opcode >> 8) & 0x000F;
+    uint8_t Y = (opcode >> 4) & 0x000F;
+
+    uint8_t *VX = s->V[X], *VY = s->V[Y], *VF = s->V[0xF];
+    uint8_t take[CHIP8_LANES];
+
+    EACH_LANE s->PC[l] += m[l] & 2;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (NN == 0xE0) {           // 00E0: CLS
+                EACH_LANE if (m[l]) memset(s->display[l], 0, sizeof s->display[l]);
+            } else if (NN == 0xEE) {    // 00EE: RET
+                EACH_LANE if (m[l]) s->PC[l] = s->stack[--s->sp[l] & 15][l];
+            } else {
+                CHIP8_OP_LOG("SYS call 0x%03X ignored", NNN);
+            }
+            break;
+
+        case 0x1: // 1NNN: JP addr
+            EACH_LANE s->PC[l] = m[l] ? NNN : s->PC[l];
+            break;
+
+        case 0x2: // 2NNN: CALL addr
+            EACH_LANE if (m[l]) {
+                s->stack[s->sp[l]++ & 15][l] = s->PC[l];
+                s->PC[l] = NNN;
+            }
+            break;
+
+        case 0x3: // 3XNN: SE Vx, NN
+            EACH_LANE take[l] = m[l] & (VX[l] == NN ? 2 : 0);
+            skip(s, take);
+            break;
+
+        case 0x4: // 4XNN: SNE Vx, NN
+            EACH_LANE take[l] = m[l] & (VX[l] != NN ? 2 : 0);
+            skip(s, take);
+            break;
+
+        case 0x5: // 5XY0: SE Vx, Vy
+            if (N != 0) break;
+            EACH_LANE take[l] = m[l] & (VX[l] == VY[l] ? 2 : 0);
+            skip(s, take);
+            break;
+
+        case 0x6: // 6XNN: LD Vx, NN
+            EACH_LANE VX[l] = BLEND(VX[l], NN, m[l]);
+            break;
+
+        case 0x7: // 7XNN: ADD Vx, NN
+            EACH_LANE VX[l] += NN & m[l];
+            break;
+
+        case 0x8: {
+            // results go to lane arrays of their own and are copied back after,
+            // so the loops vectorize though VX, VY and VF may be one register.
+            // compute_instruction sets VF first and reads VX / VY again after
+            // it, hence fx / fy: the new flag where X or Y is F
+            uint8_t f[CHIP8_LANES], x[CHIP8_LANES];
+            const uint8_t *fx = X == 0xF ? f : VX, *fy = Y == 0xF ? f : VY;
+
+            switch (N) {
+                case 0x0: EACH_LANE x[l] = BLEND(VX[l], VY[l], m[l]); break;  // 8XY0: LD
+                case 0x1: EACH_LANE x[l] = VX[l] | (VY[l] & m[l]); break;     // 8XY1: OR
+                case 0x2: EACH_LANE x[l] = VX[l] & (VY[l] | ~m[l]); break;    // 8XY2: AND
+                case 0x3: EACH_LANE x[l] = VX[l] ^ (VY[l] & m[l]); break;     // 8XY3: XOR
+                case 0x4: EACH_LANE {                                         // 8XY4: ADD
+                    uint8_t sum = VX[l] + VY[l];
+                    f[l] = BLEND(VF[l], sum < VX[l], m[l]);
+                    x[l] = BLEND(VX[l], sum, m[l]);
+                }
+                    break;
+                case 0x5:                                                     // 8XY5: SUB
+                    EACH_LANE f[l] = BLEND(VF[l], VX[l] > VY[l], m[l]);
+                    EACH_LANE x[l] = fx[l] - (fy[l] & m[l]);
+                    break;
+                case 0x6:                                                     // 8XY6: SHR
+                    EACH_LANE f[l] = BLEND(VF[l], VX[l] & 0x1, m[l]);
+                    EACH_LANE x[l] = BLEND(fx[l], fx[l] >> 1, m[l]);
+                    break;
+                case 0x7:                                                     // 8XY7: SUBN
+                    EACH_LANE f[l] = BLEND(VF[l], VY[l] > VX[l], m[l]);
+                    EACH_LANE x[l] = BLEND(fx[l], (uint8_t)(fy[l] - fx[l]), m[l]);
+                    break;
+                case 0xE:                                                     // 8XYE: SHL
+                    EACH_LANE f[l] = BLEND(VF[l], VX[l] >> 7, m[l]);
+                    EACH_LANE x[l] = BLEND(fx[l], (uint8_t)(fx[l] << 1), m[l]);
+                    break;
+                default:
+                    CHIP8_OP_LOG("Unknown 0x8 opcode: 0x%04X", opcode);
+                    return;
+            }
+
+            if (N >= 0x4) memcpy(VF, f, sizeof f);
+            memcpy(VX, x, sizeof x);
+            break;
+        }
+
+        case 0x9: // 9XY0: SNE Vx, Vy
+            if (N != 0) break;
+            EACH_LANE take[l] = m[l] & (VX[l] != VY[l] ? 2 : 0);
+            skip(s, take);
+            break;
+
+        case 0xA: // ANNN: LD I, addr
+            EACH_LANE s->I[l] = m[l] ? NNN : s->I[l];
+            break;
+
+        case 0xB: { // BNNN: JP V0 + addr
+            uint16_t pc[CHIP8_LANES];
+            EACH_LANE pc[l] = BLEND16(s->PC[l], NNN + s->V[0][l], m[l]);
+            memcpy(s->PC, pc, sizeof pc);
+            break;
+        }
+
+        case 0xC: // CXNN: RND Vx, byte
+            EACH_LANE if (m[l]) VX[l] = chip8_xorshift(&s->rng[l]) & NN;
+            break;
+
+        case 0xD: // DXYN: DRW Vx, Vy, N
+            EACH_LANE if (m[l]) {
+                uint8_t x = VX[l] % CHIP8_WIDTH;
+                uint8_t y = VY[l] % CHIP8_HEIGHT;
+
+                VF[l] = 0;
+                for (int row = 0; row < N; row++) {
+                    uint64_t bits = chip8_sprite_row(s->ram[l][(s->I[l] + row) & RAM_MASK], x);
+                    uint64_t *line = &s->display[l][(y + row) % CHIP8_HEIGHT];
+
+                    if (*line & bits) VF[l] = 1;
+                    *line ^= bits;
+                }
+            }
+            break;
+
+        case 0xE:
+            if (NN == 0x9E) {           // EX9E: skip if key VX pressed
+                EACH_LANE take[l] = m[l] & ((s->keys[l] >> (VX[l] & 0xF)) & 1 ? 2 : 0);
+                skip(s, take);
+            } else if (NN == 0xA1) {    // EXA1: skip if key VX not pressed
+                EACH_LANE take[l] = m[l] & ((s->keys[l] >> (VX[l] & 0xF)) & 1 ? 0 : 2);
+                skip(s, take);
+            } else {
+                CHIP8_OP_LOG("Unknown 0xE opcode: 0x%04X", opcode);
+            }
+            break;
+
+        case 0xF: {
+            // through lane arrays like 8XYN, VX may alias the timers and I
+            uint8_t b[CHIP8_LANES];
+            uint16_t w[CHIP8_LANES];
+
+            switch (NN) {
+                case 0x07:
+                    EACH_LANE b[l] = BLEND(VX[l], s->timer1[l], m[l]);
+                    memcpy(VX, b, sizeof b);
+                    break;
+                case 0x0A: EACH_LANE if (m[l]) {       // wait for key, PC stays put
+                    if (s->keys[l]) VX[l] = __builtin_ctz(s->keys[l]);
+                    else s->PC[l] -= 2;
+                }
+                    break;
+                case 0x15:
+                    EACH_LANE b[l] = BLEND(s->timer1[l], VX[l], m[l]);
+                    memcpy(s->timer1, b, sizeof b);
+                    break;
+                case 0x18:
+                    EACH_LANE b[l] = BLEND(s->timer2[l], VX[l], m[l]);
+                    memcpy(s->timer2, b, sizeof b);
+                    break;
+                case 0x1E:
+                    EACH_LANE w[l] = s->I[l] + (VX[l] & m[l]);
+                    memcpy(s->I, w, sizeof w);
+                    break;
+                case 0x29:
+                    EACH_LANE w[l] = BLEND16(s->I[l], CHIP8_FONT_ADDR + VX[l] * 5, m[l]);
+                    memcpy(s->I, w, sizeof w);
+                    break;
+                case 0x33: EACH_LANE if (m[l]) {
+                    uint8_t *ram = s->ram[l];
+                    ram[s->I[l] & RAM_MASK] = VX[l] / 100;
+                    ram[(s->I[l] + 1) & RAM_MASK] = (VX[l] / 10) % 10;
+                    ram[(s->I[l] + 2) & RAM_MASK] = VX[l] % 10;
+                }
+                    break;
+                case 0x55: EACH_LANE if (m[l]) {
+                    for (int i = 0; i <= X; i++)
+                        s->ram[l][(s->I[l] + i) & RAM_MASK] = s->V[i][l];
+                }
+                    break;
+                case 0x65: EACH_LANE if (m[l]) {
+                    for (int i = 0; i <= X; i++)
+                        s->V[i][l] = s->ram[l][(s->I[l] + i) & RAM_MASK];
+                }
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+    }
+}
+
+
+// n instructions on every lane, grouping lanes at the same PC and opcode
+static void run_lanes(chip8_lanes_t *s, uint32_t n) {
+    uint32_t left[CHIP8_LANES];
+    uint8_t m[CHIP8_LANES];
+
+    EACH_LANE left[l] = l < s->count ? n : 0;
+
+    for (;;) {
+        int leader = -1;
+
+        EACH_LANE if (left[l] && (leader < 0 || s->PC[l] < s->PC[leader])) leader = l;
+        if (leader < 0) break;
+
+        uint16_t pc = s->PC[leader];
+        uint8_t hi = s->ram[leader][pc & RAM_MASK];
+        uint8_t lo = s->ram[leader][(pc + 1) & RAM_MASK];
+
+        EACH_LANE m[l] = left[l] && s->PC[l] == pc && s->ram[l][pc & RAM_MASK] == hi
+                         && s->ram[l][(pc + 1) & RAM_MASK] == lo ? 0xFF : 0;
+
+        step(s, m, (hi << 8) | lo);
+
+        EACH_LANE left[l] -= m[l] & 1;
+        s->groups++;
+    }
+}
+
+
+void chip8_lanes_init(chip8_lanes_t *lanes, const chip8_t *chip8, int count) {
+    memset(lanes, 0, sizeof *lanes);
+    lanes->count = count < CHIP8_LANES ? count : CHIP8_LANES;
+
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++)
+        keys |= chip8->keyboard[i] << i;
+
+    for (int l = 0; l < lanes->count; l++) {
+        memcpy(lanes->ram[l], chip8->ram, sizeof chip8->ram);
+        memcpy(lanes->display[l], chip8->display, sizeof chip8->display);
+        for (int i = 0; i < 16; i++) lanes->V[i][l] = chip8->V_reg[i];
+        for (int i = 0; i < 12; i++) lanes->stack[i][l] = chip8->stack[i];
+        lanes->sp[l] = chip8->stack_pointer;
+        lanes->PC[l] = chip8->PC;
+        lanes->I[l] = chip8->I;
+        lanes->timer1[l] = chip8->timer1;
+        lanes->timer2[l] = chip8->timer2;
+        lanes->keys[l] = keys;
+        lanes->rng[l] = chip8->rng;
+    }
+}
+
+
+void chip8_lanes_seed(chip8_lanes_t *lanes, int lane, uint32_t seed) {
+    chip8_t tmp;
+    chip8_seed(&tmp, seed);     // same zero-seed rule as a single machine
+    lanes->rng[lane] = tmp.rng;
+}
+
+
+void chip8_lanes_run(chip8_lanes_t *lanes, chip8_sched_t *sched, uint64_t cycles) {
+    while (cycles) {
+        bool tick;
+        uint32_t n = chip8_sched_slice(sched, cycles, &tick);
+
+        if (tick) {
+            EACH_LANE {
+                lanes->timer1[l] -= lanes->timer1[l] > 0;
+                lanes->timer2[l] -= lanes->timer2[l] > 0;
+            }
+        }
+
+        run_lanes(lanes, n);
+        cycles -= n;
+    }
+}
+
+
+void chip8_lanes_get(const chip8_lanes_t *lanes, int lane, chip8_t *chip8) {
+    memcpy(chip8->ram, lanes->ram[lane], sizeof chip8->ram);
+    memcpy(chip8->display, lanes->display[lane], sizeof chip8->display);
+    for (int i = 0; i < 16; i++) chip8->V_reg[i] = lanes->V[i][lane];
+    for (int i = 0; i < 12; i++) chip8->stack[i] = lanes->stack[i][lane];
+    for (int i = 0; i < 16; i++) chip8->keyboard[i] = (lanes->keys[lane] >> i) & 1;
+    chip8->stack_pointer = lanes->sp[lane];
+    chip8->PC = lanes->PC[lane];
+    chip8->I = lanes->I[lane];
+    chip8->timer1 = lanes->timer1[lane];
+    chip8->timer2 = lanes->timer2[lane];
+    chip8->rng = lanes->rng[lane];
+}
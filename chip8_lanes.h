@@ -0,0 +1,47 @@
+#ifndef CHIP8_LANES_H
+#define CHIP8_LANES_H
+
+#include "chip8_core.h"
+#include "chip8_sched.h"
+
+
+/* lockstep core: CHIP8_LANES copies of one rom (different seeds / keys)
+ * stored structure-of-arrays, so an instruction shared by several lanes is
+ * applied to all of them with per-lane masks in loops the compiler turns
+ * into SSE2/AVX2 byte ops: loads, ALU, skips, jumps, timers and I. calls and
+ * returns, CXNN, DXYN, FX0A and the ram ops (FX33/FX55/FX65) still go lane
+ * by lane. lanes whose PC or opcode split off are run as their own group,
+ * picked lowest PC first so they tend to merge again.
+ */
+
+#define CHIP8_LANES 32
+
+typedef struct {
+    uint8_t V[16][CHIP8_LANES];
+    uint16_t PC[CHIP8_LANES];
+    uint16_t I[CHIP8_LANES];
+    uint8_t sp[CHIP8_LANES];
+    uint16_t stack[16][CHIP8_LANES];    // 12 used, 16 so sp & 15 stays in bounds
+    uint8_t timer1[CHIP8_LANES];
+    uint8_t timer2[CHIP8_LANES];
+    uint16_t keys[CHIP8_LANES];     // bit per CHIP8 key
+    uint32_t rng[CHIP8_LANES];
+    uint64_t display[CHIP8_LANES][CHIP8_HEIGHT];
+    uint8_t ram[CHIP8_LANES][CHIP8_RAM_SIZE];
+    int count;                      // lanes in use
+    uint64_t groups;                // instruction groups issued, for lockstep stats
+}chip8_lanes_t;
+
+
+// copy one loaded machine into count lanes
+void chip8_lanes_init(chip8_lanes_t *lanes, const chip8_t *chip8, int count);
+
+void chip8_lanes_seed(chip8_lanes_t *lanes, int lane, uint32_t seed);
+
+// run cycles instructions on every lane, timers ticked by sched like chip8_sched_run
+void chip8_lanes_run(chip8_lanes_t *lanes, chip8_sched_t *sched, uint64_t cycles);
+
+// copy one lane back out to a chip8_t (hashing, dumps)
+void chip8_lanes_get(const chip8_lanes_t *lanes, int lane, chip8_t *chip8);
+
+#endif // CHIP8_LANES_H
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "chip8_prof.h"
+
+
+static const struct {
+    const char *name;
+    int tid;    // trace row
+} phases[PROF_PHASES] = {
+    [PROF_EMULATE] = { "emulate", 2 },
+    [PROF_SLEEP]   = { "sleep",   2 },
+    [PROF_INPUT]   = { "input",   1 },
+    [PROF_RENDER]  = { "render",  1 },
+    [PROF_IDLE]    = { "idle",    1 },
+};
+
+static const char *families[16] = {
+    "0NNN sys/cls/ret", "1NNN jp", "2NNN call", "3XNN se", "4XNN sne", "5XY0 se", "6XNN ld",
+    "7XNN add", "8XYN alu", "9XY0 sne", "ANNN ld i", "BNNN jp v0", "CXNN rnd", "DXYN drw",
+    "EXNN skp", "FXNN misc",
+};
+
+
+uint64_t chip8_prof_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+bool chip8_prof_init(chip8_prof_t *prof, bool trace) {
+    memset(prof, 0, sizeof *prof);
+    prof->epoch = chip8_prof_now();
+
+    for (int i = 0; trace && i < PROF_PHASES; i++) {
+        prof->spans[i].trace = malloc(CHIP8_PROF_TRACE_MAX * 2 * sizeof(uint64_t));
+        if (!prof->spans[i].trace) {
+            chip8_prof_free(prof);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void chip8_prof_free(chip8_prof_t *prof) {
+    for (int i = 0; i < PROF_PHASES; i++) {
+        free(prof->spans[i].trace);
+        prof->spans[i].trace = NULL;
+    }
+}
+
+
+void chip8_hist_add(chip8_hist_t *hist, uint64_t value) {
+    int bucket = value ? 63 - __builtin_clzll(value) : 0;
+    if (bucket >= CHIP8_PROF_BUCKETS) bucket = CHIP8_PROF_BUCKETS - 1;
+
+    hist->count++;
+    hist->total += value;
+    if (value > hist->max) hist->max = value;
+    hist->buckets[bucket]++;
+}
+
+
+void chip8_prof_span(chip8_prof_t *prof, chip8_prof_phase_t phase, uint64_t start, uint64_t end) {
+    chip8_prof_span_t *span = &prof->spans[phase];
+
+    chip8_hist_add(&span->ns, end - start);
+
+    if (span->trace && span->trace_len < CHIP8_PROF_TRACE_MAX) {
+        span->trace[2 * span->trace_len] = start - prof->epoch;
+        span->trace[2 * span->trace_len + 1] = end - start;
+        span->trace_len++;
+    }
+}
+
+
+uint64_t chip8_prof_mark(chip8_prof_t *prof, chip8_prof_phase_t phase, uint64_t start) {
+    if (!prof) return 0;
+
+    uint64_t now = chip8_prof_now();
+    chip8_prof_span(prof, phase, start, now);
+    return now;
+}
+
+
+static void print_hist(const chip8_hist_t *hist, const char *unit, double scale, FILE *out) {
+    for (int i = 0; i < CHIP8_PROF_BUCKETS; i++) {
+        if (!hist->buckets[i]) continue;
+        fprintf(out, "    %10.1f .. %-10.1f %s %10" PRIu64 "  %5.1f%%\n",
+                ((uint64_t)1 << i) / scale, ((uint64_t)2 << i) / scale, unit,
+                hist->buckets[i], 100.0 * hist->buckets[i] / hist->count);
+    }
+}
+
+
+// indexes of the k largest nonzero counts, largest first
+static int top(const uint64_t *counts, int n, int *index, int k) {
+    int found = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!counts[i]) continue;
+
+        int at = found < k ? found++ : k;
+        while (at > 0 && counts[index[at - 1]] < counts[i]) {
+            if (at < k) index[at] = index[at - 1];
+            at--;
+        }
+        if (at < k) index[at] = i;
+    }
+    return found;
+}
+
+
+static uint16_t opcode_at(const uint8_t *ram, int addr) {
+    return (ram[addr] << 8) | ram[(addr + 1) & (CHIP8_RAM_SIZE - 1)];
+}
+
+
+// flat profile, routines, call edges and backward-jump loops
+static void report_addresses(const chip8_prof_t *prof, const uint8_t *ram, uint64_t ops, FILE *out) {
+    static uint64_t edges[CHIP8_RAM_SIZE], loops[CHIP8_RAM_SIZE];
+    int index[CHIP8_PROF_TOP];
+    int n;
+
+    fprintf(out, "hot addresses\n");
+    n = top(prof->pc, CHIP8_RAM_SIZE, index, CHIP8_PROF_TOP);
+    for (int i = 0; i < n; i++)
+        fprintf(out, "    0x%03X  %04X %12" PRIu64 "  %5.1f%%\n", index[i], opcode_at(ram, index[i]),
+                prof->pc[index[i]], 100.0 * prof->pc[index[i]] / ops);
+
+    fprintf(out, "routines (self instructions)\n");
+    n = top(prof->self, CHIP8_RAM_SIZE, index, CHIP8_PROF_TOP);
+    for (int i = 0; i < n; i++)
+        fprintf(out, "    0x%03X%s %12" PRIu64 "  %5.1f%%\n", index[i], index[i] == CHIP8_ROM_ADDR ? " main" : "     ",
+                prof->self[index[i]], 100.0 * prof->self[index[i]] / ops);
+
+    // a 2NNN site always calls the same routine, its count is the edge count;
+    // a 1NNN jumping backwards closes a loop over [NNN, site]
+    for (int pc = 0; pc < CHIP8_RAM_SIZE; pc++) {
+        uint16_t opcode = opcode_at(ram, pc);
+
+        edges[pc] = (opcode >> 12) == 0x2 ? prof->pc[pc] : 0;
+        loops[pc] = 0;
+        if ((opcode >> 12) == 0x1 && (opcode & 0x0FFF) <= pc && prof->pc[pc])
+            for (int a = opcode & 0x0FFF; a <= pc; a++) loops[pc] += prof->pc[a];
+    }
+
+    n = top(edges, CHIP8_RAM_SIZE, index, CHIP8_PROF_TOP);
+    if (n) fprintf(out, "call edges\n");
+    for (int i = 0; i < n; i++)
+        fprintf(out, "    0x%03X -> 0x%03X %12" PRIu64 "\n", index[i], opcode_at(ram, index[i]) & 0x0FFF, edges[index[i]]);
+
+    n = top(loops, CHIP8_RAM_SIZE, index, CHIP8_PROF_TOP);
+    if (n) fprintf(out, "loops                 iterations  instructions\n");
+    for (int i = 0; i < n; i++) {
+        int start = opcode_at(ram, index[i]) & 0x0FFF;
+        bool polls = false;
+
+        for (int a = start; a <= index[i]; a++)
+            if (prof->pc[a] && (opcode_at(ram, a) & 0xF0FF) == 0xF007) polls = true;
+
+        fprintf(out, "    0x%03X..0x%03X %12" PRIu64 " %12" PRIu64 "  %5.1f%%%s\n", start, index[i],
+                prof->pc[index[i]], loops[index[i]], 100.0 * loops[index[i]] / ops,
+                polls ? "  polls DT (FX07)" : "");
+    }
+}
+
+
+void chip8_prof_report(const chip8_prof_t *prof, const uint8_t *ram, FILE *out) {
+    uint64_t wall = chip8_prof_now() - prof->epoch;
+
+    uint64_t ops = 0;
+    for (int i = 0; i < 16; i++) ops += prof->ops[i];
+
+    fprintf(out, "profile over %.3f s\n", wall / 1e9);
+
+    if (ops) {
+        fprintf(out, "opcode families (%" PRIu64 " instructions)\n", ops);
+        for (int i = 0; i < 16; i++)
+            if (prof->ops[i])
+                fprintf(out, "    %-18s %12" PRIu64 "  %5.1f%%\n", families[i], prof->ops[i], 100.0 * prof->ops[i] / ops);
+        report_addresses(prof, ram, ops, out);
+    } else {
+        fprintf(out, "opcode counts need a -DCHIP8_PROFILE build\n");
+    }
+
+    fprintf(out, "phases                    count     total ms  mean us   max us  %% of wall\n");
+    for (int i = 0; i < PROF_PHASES; i++) {
+        const chip8_hist_t *ns = &prof->spans[i].ns;
+        if (!ns->count) continue;
+        fprintf(out, "    %-16s %10" PRIu64 " %12.1f %8.1f %8.1f  %6.1f%%\n", phases[i].name, ns->count,
+                ns->total / 1e6, ns->total / 1e3 / ns->count, ns->max / 1e3, 100.0 * ns->total / wall);
+    }
+
+    for (int i = 0; i < PROF_PHASES; i++) {
+        if (!prof->spans[i].ns.count) continue;
+        fprintf(out, "%s time histogram\n", phases[i].name);
+        print_hist(&prof->spans[i].ns, "us", 1000, out);
+    }
+
+    if (prof->cycles.count) {
+        fprintf(out, "instructions per emulation slice (mean %.1f)\n",
+                (double)prof->cycles.total / prof->cycles.count);
+        print_hist(&prof->cycles, "ins", 1, out);
+    }
+}
+
+
+bool chip8_prof_write_heatmap(const chip8_prof_t *prof, const char *path) {
+    uint64_t max = 0;
+    for (int i = 0; i < CHIP8_RAM_SIZE; i++)
+        if (prof->pc[i] > max) max = prof->pc[i];
+
+    if (!max) {
+        CHIP8_LOG("No address counts for the heatmap, build with -DCHIP8_PROFILE");
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        CHIP8_LOG("Could not write heatmap %s", path);
+        return false;
+    }
+
+    // brightness by bit length of the count, both bytes of an opcode light up
+    uint8_t pixels[CHIP8_RAM_SIZE] = {0};
+    int max_bits = 64 - __builtin_clzll(max);
+    for (int i = 0; i < CHIP8_RAM_SIZE; i++) {
+        if (!prof->pc[i]) continue;
+        int bits = 64 - __builtin_clzll(prof->pc[i]);
+        pixels[i] = pixels[(i + 1) & (CHIP8_RAM_SIZE - 1)] = 1 + 254 * bits / max_bits;
+    }
+
+    fprintf(file, "P5\n64 64\n255\n");
+    fwrite(pixels, sizeof pixels, 1, file);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+
+bool chip8_prof_write_trace(const chip8_prof_t *prof, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        CHIP8_LOG("Could not write trace %s", path);
+        return false;
+    }
+
+    // chrome trace event format, complete ("X") events in microseconds
+    fprintf(file, "{\"traceEvents\":[\n"
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"render\"}},\n"
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"emulation\"}}");
+
+    for (int i = 0; i < PROF_PHASES; i++) {
+        const chip8_prof_span_t *span = &prof->spans[i];
+
+        for (size_t e = 0; e < span->trace_len; e++)
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    phases[i].name, phases[i].tid, span->trace[2 * e] / 1e3, span->trace[2 * e + 1] / 1e3);
+    }
+
+    fprintf(file, "\n]}\n");
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
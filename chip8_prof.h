@@ -0,0 +1,97 @@
+#ifndef CHIP8_PROF_H
+#define CHIP8_PROF_H
+
+#include "chip8_core.h"
+
+
+/* profiling
+ * opcode family and per-address counters, plus a shadow call stack that
+ * charges each instruction to the routine it runs in, are bumped by every
+ * core, but only in builds with -DCHIP8_PROFILE (see CHIP8_PROF_OP);
+ * without it they compile away. the report lists the hottest addresses,
+ * routines, call edges and loops (flagging FX07 timer polls), and
+ * --heatmap writes the address counts as an image. phase
+ * timings (emulation vs render vs sleeping) and the instructions-per-slice
+ * histogram are taken by the frontend when --profile is given, reported on
+ * exit and optionally written as a Chrome trace (chrome://tracing, Perfetto).
+ */
+
+#define CHIP8_PROF_BUCKETS 32       // log2 buckets, bucket i holds [2^i, 2^(i+1))
+#define CHIP8_PROF_TRACE_MAX (1 << 18)  // spans kept per phase for the trace
+#define CHIP8_PROF_DEPTH 16         // shadow call stack
+#define CHIP8_PROF_TOP 16           // rows per report table
+
+typedef enum {
+    PROF_EMULATE,   // emulation thread: scheduler slices
+    PROF_SLEEP,     // emulation thread: delay between slices
+    PROF_INPUT,     // render thread: event polling
+    PROF_RENDER,    // render thread: upload + present, vsync wait included
+    PROF_IDLE,      // render thread: delay with no new frame
+    PROF_PHASES,
+}chip8_prof_phase_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[CHIP8_PROF_BUCKETS];
+}chip8_hist_t;
+
+// one phase is only ever timed from one thread
+typedef struct {
+    chip8_hist_t ns;
+    uint64_t *trace;        // start, duration pairs, NULL = no trace
+    size_t trace_len;       // pairs stored
+}chip8_prof_span_t;
+
+struct chip8_prof {
+    uint64_t ops[16];       // executions per opcode family (top nibble)
+    uint64_t pc[CHIP8_RAM_SIZE];        // executions per address
+    uint64_t self[CHIP8_RAM_SIZE];      // instructions run inside the routine entered here
+    uint16_t calls[CHIP8_PROF_DEPTH];   // shadow stack of routine entries
+    int depth;
+    uint64_t overflow;      // calls past the top that weren't pushed, their returns pop nothing
+    chip8_hist_t cycles;    // instructions per emulation slice
+    chip8_prof_span_t spans[PROF_PHASES];
+    uint64_t epoch;         // chip8_prof_now at init, trace time 0
+};
+
+
+// count one executed opcode at pc
+static inline void chip8_prof_op(chip8_prof_t *prof, uint16_t pc, uint16_t opcode) {
+    pc &= CHIP8_RAM_SIZE - 1;
+    prof->ops[opcode >> 12]++;
+    prof->pc[pc]++;
+    prof->self[prof->depth ? prof->calls[prof->depth - 1] : CHIP8_ROM_ADDR]++;
+
+    if ((opcode & 0xF000) == 0x2000) {
+        if (prof->depth < CHIP8_PROF_DEPTH) prof->calls[prof->depth++] = opcode & 0x0FFF;
+        else prof->overflow++;
+    } else if ((opcode & 0xF0FF) == 0x00EE) {
+        if (prof->overflow) prof->overflow--;
+        else if (prof->depth > 0) prof->depth--;
+    }
+}
+
+// monotonic ns
+uint64_t chip8_prof_now(void);
+
+bool chip8_prof_init(chip8_prof_t *prof, bool trace);
+void chip8_prof_free(chip8_prof_t *prof);
+
+void chip8_hist_add(chip8_hist_t *hist, uint64_t value);
+
+// time start..end spent in phase
+void chip8_prof_span(chip8_prof_t *prof, chip8_prof_phase_t phase, uint64_t start, uint64_t end);
+
+// end phase (begun at start) now and return now as the next start, no-op for NULL prof
+uint64_t chip8_prof_mark(chip8_prof_t *prof, chip8_prof_phase_t phase, uint64_t start);
+
+// ram decodes the hot addresses, loops and call edges
+void chip8_prof_report(const chip8_prof_t *prof, const uint8_t *ram, FILE *out);
+bool chip8_prof_write_trace(const chip8_prof_t *prof, const char *path);
+
+// 64x64 greyscale PGM, one pixel per ram byte, log scaled execution counts
+bool chip8_prof_write_heatmap(const chip8_prof_t *prof, const char *path);
+
+#endif // CHIP8_PROF_H
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "chip8_replay.h"
+#include "chip8_variant.h"
+
+
+void chip8_replay_init(chip8_replay_t *replay, uint32_t seed, uint64_t hz) {
+    memset(replay, 0, sizeof *replay);
+    replay->seed = seed;
+    replay->hz = hz;
+}
+
+
+void chip8_replay_free(chip8_replay_t *replay) {
+    free(replay->events);
+    replay->events = NULL;
+    replay->count = replay->capacity = 0;
+}
+
+
+static bool append(chip8_replay_t *replay, uint64_t cycle, uint16_t keys) {
+    if (replay->count == replay->capacity) {
+        size_t capacity = replay->capacity ? replay->capacity * 2 : 256;
+        chip8_input_event_t *events = realloc(replay->events, capacity * sizeof *events);
+        if (!events) {
+            CHIP8_LOG("Out of memory recording input");
+            return false;
+        }
+        replay->events = events;
+        replay->capacity = capacity;
+    }
+
+    replay->events[replay->count++] = (chip8_input_event_t){ cycle, keys };
+    return true;
+}
+
+
+void chip8_replay_record(chip8_replay_t *replay, uint64_t cycle, uint16_t keys) {
+    uint16_t last = replay->count ? replay->events[replay->count - 1].keys : 0;
+
+    if (keys != last) append(replay, cycle, keys);
+}
+
+
+bool chip8_replay_save(const chip8_replay_t *replay, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        CHIP8_LOG("Could not write recording %s", path);
+        return false;
+    }
+
+    fprintf(file, "chip8-input %d\n", CHIP8_REPLAY_VERSION);
+    fprintf(file, "seed %" PRIu32 "\nhz %" PRIu64 "\ncycles %" PRIu64 "\nvariant %s\n",
+            replay->seed, replay->hz, replay->cycles, chip8_variant_names[replay->variant]);
+    for (size_t i = 0; i < replay->count; i++)
+        fprintf(file, "%" PRIu64 " %04X\n", replay->events[i].cycle, replay->events[i].keys);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+
+bool chip8_replay_load(chip8_replay_t *replay, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        CHIP8_LOG("Recording %s not found", path);
+        return false;
+    }
+
+    int version = 0;
+    char variant[16] = "default";
+    chip8_replay_init(replay, 0, 0);
+
+    // the version first, a newer file may lay out the rest differently
+    bool ok = fscanf(file, "chip8-input %d", &version) == 1;
+    if (!ok) {
+        CHIP8_LOG("%s is not an input recording", path);
+    } else if (version < 1 || version > CHIP8_REPLAY_VERSION) {
+        CHIP8_LOG("%s is a version %d input recording, this build reads versions 1 to %d",
+                  path, version, CHIP8_REPLAY_VERSION);
+        ok = false;
+    } else if (fscanf(file, " seed %" SCNu32 " hz %" SCNu64 " cycles %" SCNu64,
+                      &replay->seed, &replay->hz, &replay->cycles) != 3
+               || (version >= 2 && fscanf(file, " variant %15s", variant) != 1)
+               || !chip8_variant_parse(variant, &replay->variant)) {
+        CHIP8_LOG("Bad header in version %d input recording %s", version, path);
+        ok = false;
+    }
+    if (!ok) {
+        fclose(file);
+        return false;
+    }
+
+    uint64_t cycle;
+    unsigned keys;
+    while (fscanf(file, "%" SCNu64 " %x", &cycle, &keys) == 2) {
+        if (!append(replay, cycle, keys)) break;
+    }
+
+    ok = feof(file);
+    if (!ok) CHIP8_LOG("Bad event in recording %s", path);
+    fclose(file);
+    return ok;
+}
+
+
+static void set_keys(chip8_t *chip8, uint16_t keys) {
+    for (int i = 0; i < 16; i++)
+        chip8->keyboard[i] = (keys >> i) & 1;
+}
+
+
+void chip8_replay_run(chip8_t *chip8, const chip8_replay_t *replay, chip8_sched_t *sched, uint64_t cycles) {
+    // events land between scheduler runs exactly where the live loop set them
+    for (size_t i = 0; i < replay->count && replay->events[i].cycle < cycles; i++) {
+        const chip8_input_event_t *event = &replay->events[i];
+
+        if (event->cycle > sched->cycles)
+            chip8_sched_run(chip8, sched, event->cycle - sched->cycles);
+        set_keys(chip8, event->keys);
+    }
+
+    if (cycles > sched->cycles)
+        chip8_sched_run(chip8, sched, cycles - sched->cycles);
+}
@@ -0,0 +1,49 @@
+#ifndef CHIP8_REPLAY_H
+#define CHIP8_REPLAY_H
+
+#include <stddef.h>
+
+#include "chip8_core.h"
+#include "chip8_sched.h"
+
+
+/* input recording
+ * key state changes are logged against the scheduler's instruction count,
+ * together with the CXNN seed and clock. fed back through the same
+ * scheduler a replay reproduces the recorded run bit for bit, headless.
+ * text file: a "chip8-input 2" line, seed/hz/cycles/variant lines, then one
+ * "cycle keys" line per change with keys as a hex bitmask. version 1 files
+ * have no variant line and replay on the default variant.
+ */
+
+#define CHIP8_REPLAY_VERSION 2
+
+typedef struct {
+    uint64_t cycle;     // instructions run before the change
+    uint16_t keys;      // bit per CHIP8 key
+}chip8_input_event_t;
+
+typedef struct {
+    uint32_t seed;
+    uint64_t hz;
+    uint64_t cycles;    // length of the recording, set by the recorder when it stops
+    chip8_variant_t variant;
+    chip8_input_event_t *events;
+    size_t count;
+    size_t capacity;
+}chip8_replay_t;
+
+
+void chip8_replay_init(chip8_replay_t *replay, uint32_t seed, uint64_t hz);
+void chip8_replay_free(chip8_replay_t *replay);
+
+// log keys at cycle if they differ from the last logged state
+void chip8_replay_record(chip8_replay_t *replay, uint64_t cycle, uint16_t keys);
+
+bool chip8_replay_save(const chip8_replay_t *replay, const char *path);
+bool chip8_replay_load(chip8_replay_t *replay, const char *path);
+
+// run cycles instructions from a fresh scheduler, applying the logged keys
+void chip8_replay_run(chip8_t *chip8, const chip8_replay_t *replay, chip8_sched_t *sched, uint64_t cycles);
+
+#endif // CHIP8_REPLAY_H
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_rewind.h"
+
+
+#define SNAP_SIZE sizeof(chip8_snapshot_t)
+
+
+static uint8_t diff(const uint8_t *a, const uint8_t *b, size_t i) {
+    return b ? a[i] ^ b[i] : a[i];
+}
+
+
+// a ^ b as (u16 zero run, u16 literal run, literal bytes) pairs, b NULL stores a;
+// literal runs only break on 4+ zero bytes so the pairs stay worth their header
+static size_t encode(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t n) {
+    uint8_t *p = out;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t start = i;
+
+        // unchanged ram is most of a frame, skip it a word at a time
+        while (i + 8 <= n) {
+            uint64_t x, y = 0;
+            memcpy(&x, a + i, 8);
+            if (b) memcpy(&y, b + i, 8);
+            if (x != y) break;
+            i += 8;
+        }
+        while (i < n && diff(a, b, i) == 0) i++;
+        if (i == n) break;
+
+        uint16_t skip = i - start;
+        start = i;
+
+        size_t zeros = 0;
+        while (i < n && zeros < 4) {
+            zeros = diff(a, b, i) ? 0 : zeros + 1;
+            i++;
+        }
+        i -= zeros;
+
+        uint16_t len = i - start;
+        memcpy(p, &skip, 2);
+        memcpy(p + 2, &len, 2);
+        p += 4;
+        for (size_t k = start; k < i; k++)
+            *p++ = diff(a, b, k);
+    }
+
+    return p - out;
+}
+
+
+// xor coded bytes into dst
+static void apply(uint8_t *dst, const uint8_t *src, size_t size) {
+    const uint8_t *end = src + size;
+
+    while (src < end) {
+        uint16_t skip, len;
+        memcpy(&skip, src, 2);
+        memcpy(&len, src + 2, 2);
+        src += 4;
+        dst += skip;
+        for (int k = 0; k < len; k++)
+            *dst++ ^= *src++;
+    }
+}
+
+
+// age 0 = newest
+static chip8_rewind_rec_t *rec(chip8_rewind_t *rw, int age) {
+    return &rw->recs[(rw->first + rw->count - 1 - age) % rw->capacity];
+}
+
+
+// drop the oldest keyframe and its deltas so history always starts on a keyframe
+static void drop_group(chip8_rewind_t *rw) {
+    do {
+        rw->first = (rw->first + 1) % rw->capacity;
+        rw->count--;
+    } while (rw->count && !rw->recs[rw->first].key);
+}
+
+
+// room for size bytes at head, evicting the oldest groups in the way
+static void make_room(chip8_rewind_t *rw, size_t size) {
+    if (rw->count == rw->capacity) drop_group(rw);
+
+    if (rw->head + size > rw->arena_size) {
+        // everything past head is older than everything before it
+        while (rw->count && rw->recs[rw->first].offset >= rw->head) drop_group(rw);
+        rw->head = 0;
+    }
+
+    while (rw->count && rw->recs[rw->first].offset >= rw->head
+           && rw->recs[rw->first].offset < rw->head + size)
+        drop_group(rw);
+}
+
+
+bool chip8_rewind_init(chip8_rewind_t *rw, int frames, size_t arena_size) {
+    memset(rw, 0, sizeof *rw);
+    rw->arena = malloc(arena_size);
+    rw->recs = malloc(frames * sizeof *rw->recs);
+
+    if (!rw->arena || !rw->recs) {
+        chip8_rewind_free(rw);
+        return false;
+    }
+
+    rw->arena_size = arena_size;
+    rw->capacity = frames;
+    return true;
+}
+
+
+void chip8_rewind_free(chip8_rewind_t *rw) {
+    free(rw->arena);
+    free(rw->recs);
+    rw->arena = NULL;
+    rw->recs = NULL;
+    rw->capacity = rw->count = 0;
+}
+
+
+void chip8_rewind_push(chip8_rewind_t *rw, const chip8_t *chip8, uint64_t frame) {
+    if (rw->capacity == 0) return;
+
+    chip8_snapshot_take(chip8, &rw->next);
+    rw->next.frame = frame;
+
+    bool key = rw->count == 0 || rw->since_key + 1 >= CHIP8_REWIND_KEY_INTERVAL;
+    size_t size = encode(rw->scratch, (uint8_t *)&rw->next, key ? NULL : (uint8_t *)&rw->cur, SNAP_SIZE);
+
+    make_room(rw, size);
+    if (rw->count == 0 && !key) {
+        // the group this delta belonged to was evicted, start a new one
+        key = true;
+        size = encode(rw->scratch, (uint8_t *)&rw->next, NULL, SNAP_SIZE);
+        make_room(rw, size);
+    }
+
+    memcpy(rw->arena + rw->head, rw->scratch, size);
+    rw->recs[(rw->first + rw->count) % rw->capacity] = (chip8_rewind_rec_t){ rw->head, size, key };
+    rw->count++;
+    rw->head += size;
+
+    rw->since_key = key ? 0 : rw->since_key + 1;
+    rw->cur = rw->next;
+}
+
+
+bool chip8_rewind_step(chip8_rewind_t *rw, chip8_t *chip8, int frames) {
+    if (frames > rw->count - 1) frames = rw->count - 1;
+    if (frames <= 0) return false;
+
+    // nearest keyframe at or before the target, then its deltas forward
+    int age = frames;
+    while (!rec(rw, age)->key) age++;
+
+    uint8_t *snap = (uint8_t *)&rw->cur;
+    memset(snap, 0, SNAP_SIZE);
+    for (; age >= frames; age--) {
+        chip8_rewind_rec_t *r = rec(rw, age);
+        apply(snap, rw->arena + r->offset, r->size);
+    }
+
+    rw->count -= frames;
+    chip8_rewind_rec_t *newest = rec(rw, 0);
+    rw->head = newest->offset + newest->size;
+
+    rw->since_key = 0;
+    while (!rec(rw, rw->since_key)->key) rw->since_key++;
+
+    chip8_snapshot_restore(chip8, &rw->cur);
+    return true;
+}
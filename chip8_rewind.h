@@ -0,0 +1,51 @@
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+#include "chip8_state.h"
+
+
+/* rewind history
+ * every frame is stored as the XOR of its snapshot with the previous one,
+ * run-length coded so unchanged ram/display bytes cost nothing, in a
+ * circular byte arena. every CHIP8_REWIND_KEY_INTERVAL frames a full
+ * keyframe is stored instead; going back replays at most that many deltas
+ * forward from the nearest older keyframe, and old history is dropped a
+ * whole keyframe group at a time.
+ */
+
+#define CHIP8_REWIND_KEY_INTERVAL 60        // 1s at 60Hz
+#define CHIP8_REWIND_FRAMES (60 * 60 * 5)   // 5 minutes
+#define CHIP8_REWIND_ARENA (4 << 20)        // bytes of coded frames
+
+typedef struct {
+    uint32_t offset;    // into the arena
+    uint32_t size;
+    bool key;           // full snapshot rather than a delta
+}chip8_rewind_rec_t;
+
+typedef struct {
+    uint8_t *arena;
+    size_t arena_size;
+    size_t head;                // next arena write
+    chip8_rewind_rec_t *recs;   // one per frame, oldest at first
+    int capacity;
+    int first;
+    int count;
+    int since_key;              // frames pushed since the newest keyframe
+    chip8_snapshot_t cur;       // newest frame, the next delta is taken against it
+    chip8_snapshot_t next;
+    uint8_t scratch[2 * sizeof(chip8_snapshot_t)];
+}chip8_rewind_t;
+
+
+bool chip8_rewind_init(chip8_rewind_t *rw, int frames, size_t arena_size);
+void chip8_rewind_free(chip8_rewind_t *rw);
+
+// record the machine as the newest frame
+void chip8_rewind_push(chip8_rewind_t *rw, const chip8_t *chip8, uint64_t frame);
+
+// restore the state frames back (clamped to the oldest kept), newer history
+// is dropped; false if there is nothing to go back to
+bool chip8_rewind_step(chip8_rewind_t *rw, chip8_t *chip8, int frames);
+
+#endif // CHIP8_REWIND_H
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_rom.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define CHIP8_ROM_MMAP
+#endif
+
+
+#define ROM_MAX_SIZE (CHIP8_RAM_SIZE - CHIP8_ROM_ADDR)
+
+
+static uint64_t fnv1a(const uint8_t *data, size_t len) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    while (len--) {
+        hash ^= *data++;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+
+// map or read the whole file, size checked like init_chip
+static bool load(chip8_rom_t *rom, const char *path) {
+#ifdef CHIP8_ROM_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        CHIP8_LOG("ROM file %s not found", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > ROM_MAX_SIZE) {
+        CHIP8_LOG("ROM file %s empty or too big", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        CHIP8_LOG("Could not map ROM file %s", path);
+        return false;
+    }
+
+    rom->map = map;
+    rom->data = map;
+    rom->size = st.st_size;
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        CHIP8_LOG("ROM file %s not found", path);
+        return false;
+    }
+
+    uint8_t *data = malloc(ROM_MAX_SIZE + 1);
+    size_t size = data ? fread(data, 1, ROM_MAX_SIZE + 1, file) : 0;
+    fclose(file);
+
+    if (size == 0 || size > ROM_MAX_SIZE) {
+        CHIP8_LOG("ROM file %s empty or too big", path);
+        free(data);
+        return false;
+    }
+
+    rom->map = NULL;
+    rom->data = data;
+    rom->size = size;
+#endif
+
+    rom->hash = fnv1a(rom->data, rom->size);
+    return true;
+}
+
+
+static void unload(chip8_rom_t *rom) {
+#ifdef CHIP8_ROM_MMAP
+    if (rom->map) munmap(rom->map, rom->size);
+#endif
+    if (!rom->map) free((void *)rom->data);
+}
+
+
+void chip8_rom_cache_init(chip8_rom_cache_t *cache) {
+    memset(cache, 0, sizeof *cache);
+}
+
+
+void chip8_rom_cache_free(chip8_rom_cache_t *cache) {
+    for (int i = 0; i < cache->rom_count; i++) {
+        unload(cache->roms[i]);
+        free(cache->roms[i]);
+    }
+    for (int i = 0; i < cache->path_count; i++)
+        free(cache->paths[i].path);
+
+    free(cache->roms);
+    free(cache->paths);
+    chip8_rom_cache_init(cache);
+}
+
+
+// the cached image with the same contents, or a new entry for rom
+static const chip8_rom_t *intern(chip8_rom_cache_t *cache, chip8_rom_t *rom) {
+    for (int i = 0; i < cache->rom_count; i++) {
+        chip8_rom_t *have = cache->roms[i];
+        if (have->hash == rom->hash && have->size == rom->size && memcmp(have->data, rom->data, rom->size) == 0) {
+            unload(rom);
+            free(rom);
+            return have;
+        }
+    }
+
+    chip8_rom_t **roms = realloc(cache->roms, (cache->rom_count + 1) * sizeof *roms);
+    if (!roms) {
+        unload(rom);
+        free(rom);
+        return NULL;
+    }
+
+    cache->roms = roms;
+    cache->roms[cache->rom_count++] = rom;
+    return rom;
+}
+
+
+const chip8_rom_t *chip8_rom_get(chip8_rom_cache_t *cache, const char *path) {
+    // jobs usually repeat the rom just looked up, so search newest first
+    for (int i = cache->path_count - 1; i >= 0; i--)
+        if (strcmp(cache->paths[i].path, path) == 0) return cache->paths[i].rom;
+
+    chip8_rom_path_t *paths = realloc(cache->paths, (cache->path_count + 1) * sizeof *paths);
+    char *copy = strdup(path);
+    if (paths) cache->paths = paths;
+    if (!paths || !copy) {
+        free(copy);
+        return NULL;
+    }
+
+    const chip8_rom_t *found = NULL;
+    chip8_rom_t *rom = malloc(sizeof *rom);
+    if (rom && load(rom, path))
+        found = intern(cache, rom);
+    else
+        free(rom);
+
+    cache->paths[cache->path_count++] = (chip8_rom_path_t){ copy, found };
+    return found;
+}
@@ -0,0 +1,43 @@
+#ifndef CHIP8_ROM_H
+#define CHIP8_ROM_H
+
+#include <stddef.h>
+
+#include "chip8_core.h"
+
+
+/* shared rom cache
+ * each rom file is mapped read-only once (mmap where there is one, read
+ * into the heap otherwise) and every machine started from it copies the
+ * image with chip8_load. identical images under different paths are kept
+ * once, matched by content hash. fill the cache up front: lookups are not
+ * thread safe, reading the images afterwards is.
+ */
+
+typedef struct {
+    uint64_t hash;          // fnv1a of the image
+    const uint8_t *data;
+    size_t size;
+    void *map;              // mmap base, NULL when data is on the heap
+}chip8_rom_t;
+
+typedef struct {
+    char *path;
+    const chip8_rom_t *rom;     // NULL if the file could not be loaded
+}chip8_rom_path_t;
+
+typedef struct {
+    chip8_rom_t **roms;         // distinct images
+    int rom_count;
+    chip8_rom_path_t *paths;    // every path looked up so far
+    int path_count;
+}chip8_rom_cache_t;
+
+
+void chip8_rom_cache_init(chip8_rom_cache_t *cache);
+void chip8_rom_cache_free(chip8_rom_cache_t *cache);
+
+// image for path, loaded on first use; NULL (logged once) if unreadable or too big
+const chip8_rom_t *chip8_rom_get(chip8_rom_cache_t *cache, const char *path);
+
+#endif // CHIP8_ROM_H
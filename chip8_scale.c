@@ -0,0 +1,256 @@
+#include <string.h>
+
+#include "chip8_scale.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCALE_X86
+#include <immintrin.h>
+#endif
+
+
+const char *const chip8_scale_kernel_names[CHIP8_SCALE_KERNEL_COUNT] = {
+    [CHIP8_SCALE_SCALAR] = "scalar",
+    [CHIP8_SCALE_SSE2] = "sse2",
+    [CHIP8_SCALE_AVX2] = "avx2",
+};
+
+
+typedef struct {
+    uint64_t (*update)(chip8_scale_t *scale, const chip8_screen_t *screen);
+    void (*expand)(uint32_t *out, const uint8_t *level, const uint32_t *palette, int factor);
+    void (*copy)(uint32_t *dst, const uint32_t *src, int width);
+}scale_kernel_t;
+
+
+static uint64_t update_scalar(chip8_scale_t *scale, const chip8_screen_t *screen) {
+    uint64_t dirty = 0;
+
+    for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+        uint8_t changed = 0;
+
+        for (int w = 0; w < 2; w++) {
+            uint64_t row = screen->rows[y][w];
+            uint8_t *level = &scale->level[y][64 * w];
+
+            for (int x = 0; x < 64; x++, row <<= 1) {
+                uint8_t now = (row >> 63) ? 255 : level[x] * scale->decay >> 8;
+                changed |= now ^ level[x];
+                level[x] = now;
+            }
+        }
+        if (changed) dirty |= 1ull << y;
+    }
+    return dirty;
+}
+
+
+static void expand_scalar(uint32_t *out, const uint8_t *level, const uint32_t *palette, int factor) {
+    for (int x = 0; x < CHIP8_HIRES_WIDTH; x++) {
+        uint32_t color = palette[level[x]];
+        for (int i = 0; i < factor; i++)
+            *out++ = color;
+    }
+}
+
+
+static void copy_scalar(uint32_t *dst, const uint32_t *src, int width) {
+    memcpy(dst, src, width * sizeof *dst);
+}
+
+
+#ifdef SCALE_X86
+
+// byte lane i of a qword tests bit 7 - i, pixels come msb first
+#define LANE_BITS 0x0102040810204080ll
+
+
+__attribute__((target("sse2")))
+static uint64_t update_sse2(chip8_scale_t *scale, const chip8_screen_t *screen) {
+    const __m128i bits = _mm_set1_epi64x(LANE_BITS);
+    const __m128i decay = _mm_set1_epi16(scale->decay);
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t dirty = 0;
+
+    for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+        __m128i changed = zero;
+
+        for (int x = 0; x < CHIP8_HIRES_WIDTH; x += 16) {
+            uint64_t v = screen->rows[y][x / 64] >> (48 - x % 64) & 0xFFFF;
+            __m128i b = _mm_set_epi64x((v & 0xFF) * 0x0101010101010101ull, (v >> 8) * 0x0101010101010101ull);
+            __m128i on = _mm_cmpeq_epi8(_mm_and_si128(b, bits), bits);
+
+            __m128i *level = (__m128i *)&scale->level[y][x];
+            __m128i was = _mm_load_si128(level);
+            __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(was, zero), decay), 8);
+            __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(was, zero), decay), 8);
+            __m128i now = _mm_or_si128(_mm_packus_epi16(lo, hi), on);
+
+            changed = _mm_or_si128(changed, _mm_xor_si128(now, was));
+            _mm_store_si128(level, now);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(changed, zero)) != 0xFFFF) dirty |= 1ull << y;
+    }
+    return dirty;
+}
+
+
+// each pixel's stores run past its factor, the next pixel writes over that
+__attribute__((target("sse2")))
+static void expand_sse2(uint32_t *out, const uint8_t *level, const uint32_t *palette, int factor) {
+    for (int x = 0; x < CHIP8_HIRES_WIDTH; x++, out += factor) {
+        __m128i color = _mm_set1_epi32(palette[level[x]]);
+        for (int i = 0; i < factor; i += 4)
+            _mm_storeu_si128((__m128i *)(out + i), color);
+    }
+}
+
+
+// plain stores: the renderer reads the texture right after, better it's still in cache
+__attribute__((target("sse2")))
+static void copy_sse2(uint32_t *dst, const uint32_t *src, int width) {
+    int x = 0;
+
+    for (; x < width && ((uintptr_t)(dst + x) & 15); x++)
+        dst[x] = src[x];
+    for (; x + 4 <= width; x += 4)
+        _mm_store_si128((__m128i *)(dst + x), _mm_loadu_si128((const __m128i *)(src + x)));
+    for (; x < width; x++)
+        dst[x] = src[x];
+}
+
+
+__attribute__((target("avx2")))
+static uint64_t update_avx2(chip8_scale_t *scale, const chip8_screen_t *screen) {
+    const __m256i bits = _mm256_set1_epi64x(LANE_BITS);
+    // spread the 4 bytes of a 32 pixel chunk over 8 lanes each, first pixel's byte first
+    const __m256i spread = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                            1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i decay = _mm256_set1_epi16(scale->decay);
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t dirty = 0;
+
+    for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+        __m256i changed = zero;
+
+        for (int x = 0; x < CHIP8_HIRES_WIDTH; x += 32) {
+            uint32_t v = screen->rows[y][x / 64] >> (32 - x % 64);
+            __m256i b = _mm256_shuffle_epi8(_mm256_set1_epi32(v), spread);
+            __m256i on = _mm256_cmpeq_epi8(_mm256_and_si256(b, bits), bits);
+
+            // unpack and pack both work within 128 bit halves, so lanes come back in order
+            __m256i *level = (__m256i *)&scale->level[y][x];
+            __m256i was = _mm256_load_si256(level);
+            __m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(was, zero), decay), 8);
+            __m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(was, zero), decay), 8);
+            __m256i now = _mm256_or_si256(_mm256_packus_epi16(lo, hi), on);
+
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(now, was));
+            _mm256_store_si256(level, now);
+        }
+        if (!_mm256_testz_si256(changed, changed)) dirty |= 1ull << y;
+    }
+    return dirty;
+}
+
+
+__attribute__((target("avx2")))
+static void expand_avx2(uint32_t *out, const uint8_t *level, const uint32_t *palette, int factor) {
+    for (int x = 0; x < CHIP8_HIRES_WIDTH; x++, out += factor) {
+        __m256i color = _mm256_set1_epi32(palette[level[x]]);
+        for (int i = 0; i < factor; i += 8)
+            _mm256_storeu_si256((__m256i *)(out + i), color);
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void copy_avx2(uint32_t *dst, const uint32_t *src, int width) {
+    int x = 0;
+
+    for (; x < width && ((uintptr_t)(dst + x) & 31); x++)
+        dst[x] = src[x];
+    for (; x + 8 <= width; x += 8)
+        _mm256_store_si256((__m256i *)(dst + x), _mm256_loadu_si256((const __m256i *)(src + x)));
+    for (; x < width; x++)
+        dst[x] = src[x];
+}
+
+#endif // SCALE_X86
+
+
+static const scale_kernel_t kernels[CHIP8_SCALE_KERNEL_COUNT] = {
+    [CHIP8_SCALE_SCALAR] = { update_scalar, expand_scalar, copy_scalar },
+#ifdef SCALE_X86
+    [CHIP8_SCALE_SSE2] = { update_sse2, expand_sse2, copy_sse2 },
+    [CHIP8_SCALE_AVX2] = { update_avx2, expand_avx2, copy_avx2 },
+#endif
+};
+
+
+bool chip8_scale_supported(chip8_scale_kernel_t kernel) {
+#ifdef SCALE_X86
+    __builtin_cpu_init();
+    if (kernel == CHIP8_SCALE_SSE2) return __builtin_cpu_supports("sse2");
+    if (kernel == CHIP8_SCALE_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+    return kernel == CHIP8_SCALE_SCALAR;
+}
+
+
+chip8_scale_kernel_t chip8_scale_best(void) {
+    chip8_scale_kernel_t kernel = CHIP8_SCALE_KERNEL_COUNT - 1;
+    while (!chip8_scale_supported(kernel))
+        kernel--;
+    return kernel;
+}
+
+
+// per channel: background + (pixel - background) * level / 255, times keep / 100
+static uint32_t blend(uint32_t background, uint32_t pixel, int level, int keep) {
+    uint32_t color = 0;
+
+    for (int shift = 0; shift < 24; shift += 8) {
+        int from = background >> shift & 0xFF;
+        int to = pixel >> shift & 0xFF;
+        int c = from + (to - from) * level / 255;
+        color |= (uint32_t)(c * keep / 100) << shift;
+    }
+    return color;
+}
+
+
+void chip8_scale_init(chip8_scale_t *scale, chip8_scale_kernel_t kernel, int phosphor, int scanlines,
+                      uint32_t background, uint32_t pixel) {
+    scale->kernel = chip8_scale_supported(kernel) ? kernel : chip8_scale_best();
+    scale->decay = phosphor > 0 ? (phosphor >= 99 ? 253 : phosphor * 256 / 100) : 0;
+    scale->scanlines = scanlines > 0;
+    memset(scale->level, 0, sizeof scale->level);
+
+    for (int level = 0; level < 256; level++) {
+        scale->palette[0][level] = blend(background, pixel, level, 100);
+        scale->palette[1][level] = blend(background, pixel, level, 100 - (scanlines > 100 ? 100 : scanlines));
+    }
+}
+
+
+uint64_t chip8_scale_update(chip8_scale_t *scale, const chip8_screen_t *screen) {
+    return kernels[scale->kernel].update(scale, screen);
+}
+
+
+void chip8_scale_rows(chip8_scale_t *scale, int factor, int top, int bottom, uint32_t *dst, size_t pitch) {
+    const scale_kernel_t *k = &kernels[scale->kernel];
+    int width = CHIP8_HIRES_WIDTH * factor;
+    // bottom quarter of each pixel row, none when there is only one output row
+    int dim = scale->scanlines && factor >= 2 ? (factor + 3) / 4 : 0;
+
+    for (int y = top; y <= bottom; y++) {
+        k->expand(scale->rows[0], scale->level[y], scale->palette[0], factor);
+        if (dim) k->expand(scale->rows[1], scale->level[y], scale->palette[1], factor);
+
+        for (int r = 0; r < factor; r++) {
+            k->copy(dst, scale->rows[r >= factor - dim], width);
+            dst = (uint32_t *)((uint8_t *)dst + pitch);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef CHIP8_SCALE_H
+#define CHIP8_SCALE_H
+
+#include <stddef.h>
+
+#include "chip8_core.h"
+#include "chip8_variant.h"
+
+
+/* software upscaler
+ * expands the 128x64 screen by a whole factor into an XRGB8888 buffer (a
+ * locked streaming texture), so nothing is left for a GPU to scale. phosphor
+ * persistence keeps a brightness byte per screen pixel that fades by a fixed
+ * fraction each frame instead of going dark at once, which hides the flicker
+ * of XOR-drawn sprites; scanlines dim the bottom output rows of each pixel
+ * row. two kernels, SSE2 and AVX2 picked at runtime, scalar elsewhere:
+ *   update - new brightness for the 8K screen pixels, 16/32 a step
+ *   expand - one output row per pixel row into a scratch row that stays in
+ *            cache, then copied to every output row it covers, so the
+ *            buffer is written once and never read
+ */
+
+#define CHIP8_SCALE_MAX_FACTOR 32   // 4096x2048
+
+typedef enum {
+    CHIP8_SCALE_SCALAR,
+    CHIP8_SCALE_SSE2,
+    CHIP8_SCALE_AVX2,
+    CHIP8_SCALE_KERNEL_COUNT,
+}chip8_scale_kernel_t;
+
+typedef struct {
+    chip8_scale_kernel_t kernel;
+    uint8_t decay;          // brightness kept per frame, /256, 0 = phosphor off
+    bool scanlines;
+    _Alignas(32) uint8_t level[CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH];  // brightness per pixel
+    uint32_t palette[2][256];   // brightness -> color, [1] for scanline rows
+    // expanded output rows, [1] from the scanline palette; the padding
+    // takes the overhang of the last pixel's stores
+    _Alignas(32) uint32_t rows[2][CHIP8_HIRES_WIDTH * CHIP8_SCALE_MAX_FACTOR + 8];
+}chip8_scale_t;
+
+extern const char *const chip8_scale_kernel_names[CHIP8_SCALE_KERNEL_COUNT];
+
+
+// fastest kernel this cpu runs
+chip8_scale_kernel_t chip8_scale_best(void);
+
+// false if the cpu lacks it
+bool chip8_scale_supported(chip8_scale_kernel_t kernel);
+
+// phosphor: percent of its brightness a pixel keeps each frame once off, 0 = off.
+// scanlines: percent the scanline rows are dimmed by, 0 = off
+void chip8_scale_init(chip8_scale_t *scale, chip8_scale_kernel_t kernel, int phosphor, int scanlines,
+                      uint32_t background, uint32_t pixel);
+
+// take a new frame (or the same one again while fading), returns the rows
+// whose brightness changed, bit y for pixel row y
+uint64_t chip8_scale_update(chip8_scale_t *scale, const chip8_screen_t *screen);
+
+// write pixel rows top..bottom at factor into dst, which starts at output row
+// top * factor and has pitch bytes per row
+void chip8_scale_rows(chip8_scale_t *scale, int factor, int top, int bottom, uint32_t *dst, size_t pitch);
+
+#endif // CHIP8_SCALE_H
@@ -0,0 +1,69 @@
+#include "chip8_sched.h"
+#include "chip8_debug.h"
+
+
+void chip8_sched_init(chip8_sched_t *sched, uint64_t hz) {
+    sched->hz = hz ? hz : CHIP8_DEFAULT_HZ;
+    sched->cycle_acc = 0;
+    sched->timer_acc = sched->hz;   // tick before the first frame like the old loop
+    sched->cycles = 0;
+    sched->frames = 0;
+    sched->beeps = 0;
+}
+
+
+uint32_t chip8_sched_slice(chip8_sched_t *sched, uint64_t cycles, bool *tick) {
+    *tick = sched->timer_acc >= sched->hz;
+    if (*tick) {
+        sched->timer_acc -= sched->hz;
+        sched->frames++;
+    }
+
+    // instructions left until the next tick, rounded up
+    uint64_t n = (sched->hz - sched->timer_acc + 59) / 60;
+    if (n > cycles) n = cycles;
+    if (n > UINT32_MAX) n = UINT32_MAX;
+
+    sched->timer_acc += n * 60;
+    sched->cycles += n;
+    return (uint32_t)n;
+}
+
+
+uint64_t chip8_sched_run(chip8_t *chip8, chip8_sched_t *sched, uint64_t cycles) {
+    uint64_t total = 0;
+
+    while (cycles && chip8->state != QUIT && !CHIP8_FAULTED(chip8) && !chip8_debug_stopped(chip8)) {
+        bool tick;
+        uint32_t n = chip8_sched_slice(sched, cycles, &tick);
+
+        if (tick) {
+            sched->beeps = sched->beeps << 1 | (chip8->timer2 > 0);
+            chip8_tick_timers(chip8);
+        }
+        uint32_t ran = chip8_run(chip8, n);
+
+        // a debugger stop ended the slice: hand back the emulated time it didn't use,
+        // so stepping keeps the timers where a free run would have them
+        if (ran < n) {
+            sched->timer_acc -= (uint64_t)(n - ran) * 60;
+            sched->cycles -= n - ran;
+        }
+        total += ran;
+        cycles -= n;
+    }
+    return total;
+}
+
+
+uint64_t chip8_sched_advance(chip8_t *chip8, chip8_sched_t *sched, uint64_t elapsed, uint64_t freq) {
+    // under load run late instructions back to back, but never more than the cap
+    if (elapsed > freq / CHIP8_MAX_CATCHUP_DIV)
+        elapsed = freq / CHIP8_MAX_CATCHUP_DIV;
+
+    sched->cycle_acc += elapsed * sched->hz;
+    uint64_t cycles = sched->cycle_acc / freq;
+    sched->cycle_acc %= freq;
+
+    return chip8_sched_run(chip8, sched, cycles);
+}
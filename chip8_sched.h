@@ -0,0 +1,40 @@
+#ifndef CHIP8_SCHED_H
+#define CHIP8_SCHED_H
+
+#include "chip8_core.h"
+
+
+/* instruction/timer scheduler
+ * instructions run at hz, the delay and sound timers tick at exactly 60Hz of
+ * emulated time in between. host time goes in as counter ticks so the
+ * frontend can feed SDL_GetPerformanceCounter deltas and stay drift free.
+ */
+
+#define CHIP8_DEFAULT_HZ (CHIP8_CYCLES_PER_FRAME * 60)
+#define CHIP8_MAX_CATCHUP_DIV 4     // at most 1/4 s of backlog, older time is dropped
+
+typedef struct {
+    uint64_t hz;            // instructions per second
+    uint64_t cycle_acc;     // host time remainder, in ticks * hz
+    uint64_t timer_acc;     // emulated time since the last timer tick, in cycles * 60
+    uint64_t cycles;        // instructions run so far
+    uint64_t frames;        // 60Hz timer ticks so far
+    uint64_t beeps;         // sound timer running in the frame each tick ended, newest in bit 0
+}chip8_sched_t;
+
+
+void chip8_sched_init(chip8_sched_t *sched, uint64_t hz);
+
+// next slice of at most cycles instructions: whether the timers tick first
+// and how many instructions to run before the following tick
+uint32_t chip8_sched_slice(chip8_sched_t *sched, uint64_t cycles, bool *tick);
+
+// run cycles instructions with timer ticks interleaved at 60Hz, returns how many ran:
+// fewer once the machine stops (debugger, fault, 00FD). a debugger stop part way
+// through a slice counts only what ran, in cycles and in timer time
+uint64_t chip8_sched_run(chip8_t *chip8, chip8_sched_t *sched, uint64_t cycles);
+
+// run whatever is due for elapsed host ticks of a freq ticks/s clock, returns instructions run
+uint64_t chip8_sched_advance(chip8_t *chip8, chip8_sched_t *sched, uint64_t elapsed, uint64_t freq);
+
+#endif // CHIP8_SCHED_H
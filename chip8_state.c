@@ -0,0 +1,197 @@
+#include <string.h>
+
+#include "chip8_state.h"
+
+
+void chip8_snapshot_take(const chip8_t *chip8, chip8_snapshot_t *snap) {
+    memcpy(snap->ram, chip8->ram, sizeof snap->ram);
+    memcpy(snap->display, chip8->display, sizeof snap->display);
+    memcpy(snap->stack, chip8->stack, sizeof snap->stack);
+    memcpy(snap->V_reg, chip8->V_reg, sizeof snap->V_reg);
+    snap->stack_pointer = chip8->stack_pointer;
+    snap->I = chip8->I;
+    snap->timer1 = chip8->timer1;
+    snap->timer2 = chip8->timer2;
+    snap->PC = chip8->PC;
+    snap->rng = chip8->rng;
+
+    snap->keys = 0;
+    for (int i = 0; i < 16; i++)
+        snap->keys |= chip8->keyboard[i] << i;
+
+    snap->variant = chip8->variant;
+    snap->hires = chip8->hires;
+    memcpy(snap->hires_display, chip8->hires_display, sizeof snap->hires_display);
+    memcpy(snap->flags, chip8->flags, sizeof snap->flags);
+}
+
+
+void chip8_snapshot_restore(chip8_t *chip8, const chip8_snapshot_t *snap) {
+    memcpy(chip8->ram, snap->ram, sizeof snap->ram);
+    memcpy(chip8->display, snap->display, sizeof snap->display);
+    memcpy(chip8->stack, snap->stack, sizeof snap->stack);
+    memcpy(chip8->V_reg, snap->V_reg, sizeof snap->V_reg);
+    chip8->stack_pointer = snap->stack_pointer;
+    chip8->I = snap->I;
+    chip8->timer1 = snap->timer1;
+    chip8->timer2 = snap->timer2;
+    chip8->PC = snap->PC;
+    chip8->rng = snap->rng;
+
+    for (int i = 0; i < 16; i++)
+        chip8->keyboard[i] = (snap->keys >> i) & 1;
+
+    chip8->hires = snap->hires;
+    memcpy(chip8->hires_display, snap->hires_display, sizeof snap->hires_display);
+    memcpy(chip8->flags, snap->flags, sizeof snap->flags);
+
+    chip8_ram_written(chip8, 0, CHIP8_RAM_SIZE);
+    chip8->dirty_rows = ~0u;
+    chip8->fault = CHIP8_FAULT_NONE;
+}
+
+
+// little endian field writers/readers
+static uint8_t *put(uint8_t *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        *p++ = (v >> (8 * i)) & 0xFF;
+    return p;
+}
+
+static const uint8_t *get(const uint8_t *p, uint64_t *v, int bytes) {
+    *v = 0;
+    for (int i = 0; i < bytes; i++)
+        *v |= (uint64_t)*p++ << (8 * i);
+    return p;
+}
+
+
+size_t chip8_state_save(const chip8_t *chip8, uint8_t *buf, size_t cap) {
+    if (cap < CHIP8_STATE_SIZE) return 0;
+
+    chip8_snapshot_t snap;
+    chip8_snapshot_take(chip8, &snap);
+
+    uint8_t *p = buf;
+    memcpy(p, CHIP8_STATE_MAGIC, 4);
+    p = put(p + 4, CHIP8_STATE_VERSION, 2);
+
+    memcpy(p, snap.ram, sizeof snap.ram);
+    p += sizeof snap.ram;
+    for (int i = 0; i < CHIP8_HEIGHT; i++) p = put(p, snap.display[i], 8);
+    for (int i = 0; i < 12; i++) p = put(p, snap.stack[i], 2);
+    p = put(p, snap.stack_pointer, 1);
+    memcpy(p, snap.V_reg, sizeof snap.V_reg);
+    p += sizeof snap.V_reg;
+    p = put(p, snap.I, 2);
+    p = put(p, snap.timer1, 1);
+    p = put(p, snap.timer2, 1);
+    p = put(p, snap.PC, 2);
+    p = put(p, snap.rng, 4);
+    p = put(p, snap.keys, 2);
+    p = put(p, snap.variant, 1);
+    p = put(p, snap.hires, 1);
+    for (int i = 0; i < CHIP8_HIRES_HEIGHT; i++) {
+        p = put(p, snap.hires_display[i][0], 8);
+        p = put(p, snap.hires_display[i][1], 8);
+    }
+    memcpy(p, snap.flags, sizeof snap.flags);
+    p += sizeof snap.flags;
+
+    return p - buf;
+}
+
+
+bool chip8_state_load(chip8_t *chip8, const uint8_t *buf, size_t len) {
+    uint64_t v;
+
+    if (len < 6 || memcmp(buf, CHIP8_STATE_MAGIC, 4) != 0) {
+        CHIP8_LOG("Not a save state");
+        return false;
+    }
+
+    const uint8_t *p = get(buf + 4, &v, 2);
+    uint64_t version = v;
+    if (version != 1 && version != CHIP8_STATE_VERSION) {
+        CHIP8_LOG("Save state version %u not supported", (unsigned)version);
+        return false;
+    }
+    if (len != (version == 1 ? CHIP8_STATE_V1_SIZE : CHIP8_STATE_SIZE)) {
+        CHIP8_LOG("Not a save state");
+        return false;
+    }
+
+    chip8_snapshot_t snap = {0};    // v1 ends at keys: default variant, lores, no flags
+    memcpy(snap.ram, p, sizeof snap.ram);
+    p += sizeof snap.ram;
+    for (int i = 0; i < CHIP8_HEIGHT; i++) p = get(p, &snap.display[i], 8);
+    for (int i = 0; i < 12; i++) { p = get(p, &v, 2); snap.stack[i] = v; }
+    p = get(p, &v, 1); snap.stack_pointer = v;
+    memcpy(snap.V_reg, p, sizeof snap.V_reg);
+    p += sizeof snap.V_reg;
+    p = get(p, &v, 2); snap.I = v;
+    p = get(p, &v, 1); snap.timer1 = v;
+    p = get(p, &v, 1); snap.timer2 = v;
+    p = get(p, &v, 2); snap.PC = v;
+    p = get(p, &v, 4); snap.rng = v;
+    p = get(p, &v, 2); snap.keys = v;
+
+    if (version >= 2) {
+        p = get(p, &v, 1); snap.variant = v;
+        p = get(p, &v, 1); snap.hires = v;
+        for (int i = 0; i < CHIP8_HIRES_HEIGHT; i++) {
+            p = get(p, &snap.hires_display[i][0], 8);
+            p = get(p, &snap.hires_display[i][1], 8);
+        }
+        memcpy(snap.flags, p, sizeof snap.flags);
+    } else {
+        snap.variant = CHIP8_VARIANT_DEFAULT;
+    }
+
+    // 00EE would read past the stack, the cores would fetch past ram
+    if (snap.stack_pointer > CHIP8_STACK_DEPTH || snap.PC >= CHIP8_RAM_SIZE) {
+        CHIP8_LOG("Save state is corrupt (SP %u, PC 0x%X)", (unsigned)snap.stack_pointer, (unsigned)snap.PC);
+        return false;
+    }
+
+    // handlers, fonts and quirks come from the variant the machine was set up with
+    if (snap.variant != chip8->variant) {
+        CHIP8_LOG("Save state is for another variant (%u)", (unsigned)snap.variant);
+        return false;
+    }
+
+    chip8_snapshot_restore(chip8, &snap);
+    return true;
+}
+
+
+bool chip8_state_save_file(const chip8_t *chip8, const char *path) {
+    uint8_t buf[CHIP8_STATE_SIZE];
+    size_t len = chip8_state_save(chip8, buf, sizeof buf);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        CHIP8_LOG("Could not write save state %s", path);
+        return false;
+    }
+
+    bool ok = fwrite(buf, len, 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+
+bool chip8_state_load_file(chip8_t *chip8, const char *path) {
+    uint8_t buf[CHIP8_STATE_SIZE + 1];
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        CHIP8_LOG("Save state %s not found", path);
+        return false;
+    }
+
+    size_t len = fread(buf, 1, sizeof buf, file);
+    fclose(file);
+    return chip8_state_load(chip8, buf, len);
+}
+
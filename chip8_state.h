@@ -0,0 +1,57 @@
+#ifndef CHIP8_STATE_H
+#define CHIP8_STATE_H
+
+#include <stddef.h>
+
+#include "chip8_core.h"
+
+
+/* save states
+ * chip8_snapshot_t is a plain copy of the machine (~5.5KB, a couple of
+ * memcpys to take), which the rewind history (chip8_rewind.h) codes frame
+ * to frame. the file format is the same fields behind a magic + version,
+ * little endian, no padding.
+ */
+
+#define CHIP8_STATE_MAGIC "C8ST"
+#define CHIP8_STATE_VERSION 2
+#define CHIP8_STATE_V1_SIZE (4 + 2 + CHIP8_RAM_SIZE + CHIP8_HEIGHT * 8 + 12 * 2 + 1 + 16 + 2 + 1 + 1 + 2 + 4 + 2)
+#define CHIP8_STATE_SIZE (CHIP8_STATE_V1_SIZE + 1 + 1 + CHIP8_HIRES_HEIGHT * 16 + 16)   // v2 adds the variant
+
+typedef struct {
+    uint8_t ram[CHIP8_RAM_SIZE];
+    uint64_t display[CHIP8_HEIGHT];
+    uint16_t stack[12];
+    uint8_t stack_pointer;
+    uint8_t V_reg[16];
+    uint16_t I;
+    uint8_t timer1;
+    uint8_t timer2;
+    uint16_t PC;
+    uint32_t rng;
+    uint16_t keys;      // bit per CHIP8 key
+    uint8_t variant;    // chip8_variant_t
+    bool hires;
+    uint64_t hires_display[CHIP8_HIRES_HEIGHT][2];
+    uint8_t flags[16];
+    uint64_t frame;     // caller's frame number when taken
+}chip8_snapshot_t;
+
+
+void chip8_snapshot_take(const chip8_t *chip8, chip8_snapshot_t *snap);
+
+// restore a snapshot, code caches are invalidated and the display redrawn
+void chip8_snapshot_restore(chip8_t *chip8, const chip8_snapshot_t *snap);
+
+// binary save state, returns bytes written (0 if cap < CHIP8_STATE_SIZE)
+size_t chip8_state_save(const chip8_t *chip8, uint8_t *buf, size_t cap);
+
+// false on bad magic, version, size, a stack pointer past CHIP8_STACK_DEPTH, a PC
+// outside ram or a state of another variant, chip8 is left untouched then.
+// v1 states (before variants) load as default
+bool chip8_state_load(chip8_t *chip8, const uint8_t *buf, size_t len);
+
+bool chip8_state_save_file(const chip8_t *chip8, const char *path);
+bool chip8_state_load_file(chip8_t *chip8, const char *path);
+
+#endif // CHIP8_STATE_H
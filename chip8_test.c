@@ -0,0 +1,729 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_core.h"
+#include "chip8_cache.h"
+#include "chip8_block.h"
+#include "chip8_sched.h"
+#include "chip8_debug.h"
+#include "chip8_state.h"
+#include "chip8_rewind.h"
+#include "chip8_lanes.h"
+#include "chip8_replay.h"
+#include "chip8_trace.h"
+#include "chip8_prof.h"
+#include "chip8_variant.h"
+
+
+/* core regression tests, no SDL
+ * each test builds its machines from a few opcodes, runs them and compares;
+ * a failed CHECK prints where and the test goes on. exits non-zero if any failed.
+ */
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+
+// fresh default machine running code from 0x200
+static void load(chip8_t *chip8, const uint16_t *code, size_t count) {
+    uint8_t rom[64];
+
+    for (size_t i = 0; i < count; i++) {
+        rom[2 * i] = code[i] >> 8;
+        rom[2 * i + 1] = code[i] & 0xFF;
+    }
+    memset(chip8, 0, sizeof *chip8);
+    chip8_load(chip8, rom, 2 * count);
+    chip8_seed(chip8, 1);
+}
+
+
+// everything a core changes matches
+static bool same_machine(const chip8_t *a, const chip8_t *b) {
+    return a->state == b->state && a->fault == b->fault &&
+           memcmp(a->ram, b->ram, sizeof a->ram) == 0 &&
+           memcmp(a->display, b->display, sizeof a->display) == 0 &&
+           memcmp(a->hires_display, b->hires_display, sizeof a->hires_display) == 0 &&
+           a->dirty_rows == b->dirty_rows && a->hires == b->hires &&
+           memcmp(a->stack, b->stack, sizeof a->stack) == 0 && a->stack_pointer == b->stack_pointer &&
+           memcmp(a->V_reg, b->V_reg, sizeof a->V_reg) == 0 && a->I == b->I && a->PC == b->PC &&
+           a->timer1 == b->timer1 && a->timer2 == b->timer2 && a->rng == b->rng &&
+           memcmp(a->flags, b->flags, sizeof a->flags) == 0;
+}
+
+
+// N single steps through the debugger leave the machine, its timers and the
+// scheduler's counts where N free-running instructions do
+static void test_debug_steps_match_free_run(void) {
+    static const uint16_t code[] = {
+        0x60C8,     // V0 = 200
+        0xF015,     // DT = V0
+        0x7101,     // V1 += 1
+        0x1204,     // jump back to it
+    };
+
+    for (uint32_t steps = 1; steps <= 40; steps++) {
+        chip8_t stepped, free;
+        chip8_sched_t stepped_sched, free_sched;
+        chip8_debug_t debug;
+
+        load(&stepped, code, sizeof code / sizeof code[0]);
+        load(&free, code, sizeof code / sizeof code[0]);
+        chip8_debug_init(&debug);
+        stepped.debug = &debug;
+        chip8_sched_init(&stepped_sched, CHIP8_DEFAULT_HZ);
+        chip8_sched_init(&free_sched, CHIP8_DEFAULT_HZ);
+
+        uint64_t ran = 0;
+        for (uint32_t i = 0; i < steps; i++) {
+            chip8_debug_step(&debug, 1);
+            ran += chip8_sched_run(&stepped, &stepped_sched, CHIP8_DEFAULT_HZ);
+        }
+        chip8_sched_run(&free, &free_sched, steps);
+
+        CHECK(ran == steps);
+        CHECK(stepped_sched.cycles == steps);
+        CHECK(stepped_sched.cycles == free_sched.cycles);
+        CHECK(stepped_sched.frames == free_sched.frames);
+        CHECK(stepped_sched.timer_acc == free_sched.timer_acc);
+        CHECK(stepped.timer1 == free.timer1);
+        CHECK(stepped.V_reg[1] == free.V_reg[1]);
+        CHECK(chip8_hash(&stepped) == chip8_hash(&free));
+    }
+}
+
+
+// a v1 state (a v2 one without the variant tail) of a default machine
+// loads back to the same machine and saves again as the v2 state; other
+// variants refuse it
+static void test_state_v1_loads_as_default(void) {
+    static const uint16_t code[] = {
+        0xA300,     // I = 0x300
+        0x6107,     // V1 = 7
+        0x2208,     // call 0x208
+        0x1206,     // loop here
+        0xF133,     // BCD of V1 at I
+        0xD125,     // draw 5 rows at (V1, V2)
+        0x00EE,
+    };
+    chip8_t chip8, loaded;
+    chip8_sched_t sched;
+
+    load(&chip8, code, sizeof code / sizeof code[0]);
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+    chip8_sched_run(&chip8, &sched, 40);
+
+    uint8_t saved[CHIP8_STATE_SIZE], buf[CHIP8_STATE_SIZE];
+    CHECK(chip8_state_save(&chip8, saved, sizeof saved) == CHIP8_STATE_SIZE);
+    memcpy(buf, saved, sizeof buf);
+    buf[4] = 1;
+    buf[5] = 0;
+
+    load(&loaded, code, sizeof code / sizeof code[0]);
+    CHECK(chip8_state_load(&loaded, buf, CHIP8_STATE_V1_SIZE));
+    CHECK(chip8_hash(&loaded) == chip8_hash(&chip8));
+    CHECK(loaded.stack_pointer == chip8.stack_pointer && loaded.PC == chip8.PC && loaded.I == chip8.I);
+    CHECK(memcmp(loaded.display, chip8.display, sizeof chip8.display) == 0);
+    CHECK(!loaded.hires);
+    CHECK(chip8_state_save(&loaded, buf, sizeof buf) == CHIP8_STATE_SIZE);
+    CHECK(memcmp(buf, saved, sizeof buf) == 0);
+    buf[4] = 1;
+
+    // a v1 state with the v2 size, or a v2 state cut to the v1 size, is neither
+    CHECK(!chip8_state_load(&loaded, buf, CHIP8_STATE_SIZE));
+    buf[4] = CHIP8_STATE_VERSION;
+    CHECK(!chip8_state_load(&loaded, buf, CHIP8_STATE_V1_SIZE));
+
+    buf[4] = 1;
+    load(&loaded, code, sizeof code / sizeof code[0]);
+    chip8_set_variant(&loaded, CHIP8_VARIANT_SCHIP);
+    CHECK(!chip8_state_load(&loaded, buf, CHIP8_STATE_V1_SIZE));
+}
+
+
+// states with a stack pointer past the stack or a PC past ram are refused
+// and leave the machine as it was
+static void test_state_rejects_bad_sp_and_pc(void) {
+    static const uint16_t code[] = { 0x1200 };
+    chip8_t chip8;
+    uint8_t buf[CHIP8_STATE_SIZE];
+    // offsets of SP and PC in the file
+    const size_t sp_at = 4 + 2 + CHIP8_RAM_SIZE + CHIP8_HEIGHT * 8 + 12 * 2;
+    const size_t pc_at = sp_at + 1 + 16 + 2 + 1 + 1;
+
+    load(&chip8, code, sizeof code / sizeof code[0]);
+    CHECK(chip8_state_save(&chip8, buf, sizeof buf) == CHIP8_STATE_SIZE);
+    uint64_t hash = chip8_hash(&chip8);
+
+    buf[sp_at] = CHIP8_STACK_DEPTH;
+    CHECK(chip8_state_load(&chip8, buf, sizeof buf));
+    buf[sp_at] = CHIP8_STACK_DEPTH + 1;
+    CHECK(!chip8_state_load(&chip8, buf, sizeof buf));
+    buf[sp_at] = 0xFF;
+    CHECK(!chip8_state_load(&chip8, buf, sizeof buf));
+    buf[sp_at] = 0;
+
+    buf[pc_at] = CHIP8_RAM_SIZE & 0xFF;
+    buf[pc_at + 1] = CHIP8_RAM_SIZE >> 8;
+    CHECK(!chip8_state_load(&chip8, buf, sizeof buf));
+    CHECK(chip8.stack_pointer == CHIP8_STACK_DEPTH);    // still the last good load
+
+    buf[pc_at] = 0x00;
+    buf[pc_at + 1] = 0x02;
+    CHECK(chip8_state_load(&chip8, buf, sizeof buf));
+    CHECK(chip8_hash(&chip8) == hash);
+}
+
+
+// each timer tick records whether the sound timer ran through the frame it
+// ends, so a beep shorter than a catch-up burst keeps its length
+static void test_sched_records_beep_per_frame(void) {
+    static const uint16_t code[] = {
+        0x6003,     // V0 = 3
+        0xF018,     // ST = V0
+        0x1204,     // spin
+    };
+    chip8_t chip8;
+    chip8_sched_t sched;
+
+    load(&chip8, code, sizeof code / sizeof code[0]);
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+    chip8_sched_run(&chip8, &sched, 4 * CHIP8_CYCLES_PER_FRAME + 1);
+
+    // ticks before instructions 0, 8, 16, 24, 32: silent, three frames of beep, silent
+    CHECK(sched.frames == 5);
+    CHECK(sched.beeps == 0x0E);
+    CHECK(chip8.timer2 == 0);
+}
+
+
+// a delay timer wait at the default clock is fast-forwarded for nearly all
+// of its instructions and ends where running every one of them does
+static void test_idle_skip_matches_full_run(void) {
+    static const uint16_t code[] = {
+        0x6078,     // V0 = 120
+        0xF015,     // DT = V0
+        0xF007,     // 204: V0 = DT
+        0x3000,     // skip the jump once it's 0
+        0x1204,
+        0x6101,     // V1 = 1
+        0x120C,     // spin
+    };
+    const uint64_t cycles = 3 * CHIP8_DEFAULT_HZ;
+    chip8_t skipped, full;
+    chip8_sched_t skipped_sched, full_sched;
+
+    load(&skipped, code, sizeof code / sizeof code[0]);
+    load(&full, code, sizeof code / sizeof code[0]);
+    full.skip_idle = false;
+    chip8_sched_init(&skipped_sched, CHIP8_DEFAULT_HZ);
+    chip8_sched_init(&full_sched, CHIP8_DEFAULT_HZ);
+
+    CHECK(chip8_sched_run(&skipped, &skipped_sched, cycles) == cycles);
+    CHECK(chip8_sched_run(&full, &full_sched, cycles) == cycles);
+
+    CHECK(skipped.idle_skipped > cycles * 9 / 10);
+    CHECK(full.idle_skipped == 0);
+    CHECK(skipped.V_reg[1] == 1);
+    CHECK(skipped.PC == full.PC && skipped.I == full.I && skipped.timer1 == full.timer1);
+    CHECK(memcmp(skipped.V_reg, full.V_reg, sizeof full.V_reg) == 0);
+    CHECK(chip8_hash(&skipped) == chip8_hash(&full));
+    CHECK(skipped_sched.frames == full_sched.frames && skipped_sched.timer_acc == full_sched.timer_acc);
+
+    // stopped mid-wait too
+    load(&skipped, code, sizeof code / sizeof code[0]);
+    load(&full, code, sizeof code / sizeof code[0]);
+    full.skip_idle = false;
+    chip8_sched_init(&skipped_sched, CHIP8_DEFAULT_HZ);
+    chip8_sched_init(&full_sched, CHIP8_DEFAULT_HZ);
+    chip8_sched_run(&skipped, &skipped_sched, cycles / 3 + 5);
+    chip8_sched_run(&full, &full_sched, cycles / 3 + 5);
+    CHECK(skipped.idle_skipped > 0);
+    CHECK(skipped.PC == full.PC && skipped.timer1 == full.timer1 && skipped.timer1 > 0);
+    CHECK(memcmp(skipped.V_reg, full.V_reg, sizeof full.V_reg) == 0);
+}
+
+
+// runs code on variant through the scheduler in chunks of step
+// instructions, so slices also end at odd places
+static void run_code(chip8_t *chip8, const uint16_t *code, size_t count, chip8_variant_t variant,
+                     chip8_cache_t *cache, chip8_blocks_t *blocks, uint32_t cycles, uint32_t step) {
+    chip8_sched_t sched;
+
+    load(chip8, code, count);
+    chip8_set_variant(chip8, variant);
+    chip8->skip_idle = false;
+    if (cache) chip8_cache_attach(chip8, cache);
+    if (blocks) chip8_blocks_attach(chip8, blocks);
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+
+    for (uint32_t ran = 0; ran < cycles; ran += step)
+        chip8_sched_run(chip8, &sched, step);
+}
+
+
+// self-modifying code: FX55 rewriting ops of the loop (the block) it runs
+// in and FX33 rewriting the ops just run, each then run again
+static const uint16_t self_modifying_store[] = {
+    0x7301,     // 200: V3 += 1
+    0x7401,     // 202: V4 += 1, becomes V4 += 5
+    0x3308,     // skip the jump at V3 == 8
+    0x1200,
+    0xA202,     // I = 0x202
+    0x6074,
+    0x6105,
+    0xF155,     // 7405 over 202
+    0x6300,
+    0x1200,
+};
+
+static const uint16_t self_modifying_bcd[] = {
+    0xA203,     // 200: I = 0x203
+    0x7B00,     // 202: VB += hundreds of VA
+    0x6C01,     // 204: becomes SYS 0TO, tens and ones of VA
+    0x7A13,     // VA += 19
+    0xFA33,     // BCD of VA over 203..205
+    0x1202,
+};
+
+// BNNN into each op of the block it ends
+static const uint16_t jump_into_block[] = {
+    0x6606,     // 200: V6 = 6
+    0x7101,     // 202
+    0x7201,
+    0x7301,
+    0x7002,     // V0 += 2
+    0x8062,     // V0 &= 6
+    0xB202,     // jump to 202 + V0
+};
+
+
+// the cached and block cores end every program where the interpreter does,
+// through the ops they have to decode again after ram writes over them
+static void test_cores_match_interp(void) {
+    static chip8_cache_t cache;
+    static chip8_blocks_t blocks;
+    static const struct { const uint16_t *code; size_t count; } programs[] = {
+        { self_modifying_store, sizeof self_modifying_store / sizeof self_modifying_store[0] },
+        { self_modifying_bcd, sizeof self_modifying_bcd / sizeof self_modifying_bcd[0] },
+        { jump_into_block, sizeof jump_into_block / sizeof jump_into_block[0] },
+    };
+
+    for (size_t p = 0; p < sizeof programs / sizeof programs[0]; p++) {
+        for (chip8_variant_t v = 0; v < CHIP8_VARIANT_COUNT; v++) {
+            for (uint32_t step = 1; step <= 13; step += 6) {
+                chip8_t interp, cached, block;
+
+                run_code(&interp, programs[p].code, programs[p].count, v, NULL, NULL, 600, step);
+                run_code(&cached, programs[p].code, programs[p].count, v, &cache, NULL, 600, step);
+                run_code(&block, programs[p].code, programs[p].count, v, NULL, &blocks, 600, step);
+                CHECK(same_machine(&cached, &interp));
+                CHECK(same_machine(&block, &interp));
+            }
+        }
+    }
+}
+
+
+// ram written from outside the core, as a state load does, reaches ops
+// already decoded once chip8_ram_written is told
+static void test_cache_invalidated_by_ram_writes(void) {
+    static const uint16_t code[] = {
+        0x7101,     // 200: V1 += 1, becomes V2 += 1
+        0x1200,
+    };
+    static chip8_cache_t cache;
+    chip8_t chip8;
+
+    load(&chip8, code, sizeof code / sizeof code[0]);
+    chip8_cache_attach(&chip8, &cache);
+    chip8_run(&chip8, 10);
+    CHECK(chip8.V_reg[1] == 5 && chip8.V_reg[2] == 0);
+
+    chip8.ram[0x200] = 0x72;
+    chip8_ram_written(&chip8, 0x200, 1);
+    chip8_run(&chip8, 10);
+    CHECK(chip8.V_reg[1] == 5 && chip8.V_reg[2] == 5);
+
+    // the op starting the byte before a write reads it too
+    chip8.ram[0x201] = 0x03;
+    chip8_ram_written(&chip8, 0x201, 1);
+    chip8_run(&chip8, 10);
+    CHECK(chip8.V_reg[2] == 20);
+}
+
+
+// same ram, display, registers, stack, timers, rng and keys
+static bool same_snapshot(const chip8_t *a, const chip8_t *b) {
+    chip8_snapshot_t x, y;
+
+    memset(&x, 0, sizeof x);
+    memset(&y, 0, sizeof y);
+    chip8_snapshot_take(a, &x);
+    chip8_snapshot_take(b, &y);
+    return memcmp(&x, &y, sizeof x) == 0;
+}
+
+
+// stepping back across keyframes restores exactly the machine of that
+// frame, and history recorded after a step rewinds as well
+static void test_rewind_restores_frames(void) {
+    static const uint16_t code[] = {
+        0xC0FF,     // V0 = random
+        0xF029,     // I = digit V0
+        0xD125,     // draw it at V1, V2
+        0x7103,
+        0x7201,
+        0xA300,
+        0xF133,     // BCD of V1 at 300
+        0x1200,
+    };
+    static chip8_t saved[3 * CHIP8_REWIND_KEY_INTERVAL];
+    chip8_t chip8;
+    chip8_sched_t sched;
+    chip8_rewind_t rw;
+
+    CHECK(chip8_rewind_init(&rw, CHIP8_REWIND_FRAMES, CHIP8_REWIND_ARENA));
+    load(&chip8, code, sizeof code / sizeof code[0]);
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+
+    // frames 0 .. 149, keyframes at 0, 60 and 120
+    int frame;
+    for (frame = 0; frame < 150; frame++) {
+        chip8.keyboard[frame % 16] ^= true;
+        chip8_sched_run(&chip8, &sched, CHIP8_CYCLES_PER_FRAME);
+        chip8_rewind_push(&rw, &chip8, frame);
+        saved[frame] = chip8;
+    }
+
+    CHECK(chip8_rewind_step(&rw, &chip8, 100));
+    frame = 49;
+    CHECK(same_snapshot(&chip8, &saved[frame]));
+    CHECK(memcmp(chip8.ram, saved[frame].ram, sizeof chip8.ram) == 0);
+    CHECK(memcmp(chip8.display, saved[frame].display, sizeof chip8.display) == 0);
+    CHECK(memcmp(chip8.V_reg, saved[frame].V_reg, sizeof chip8.V_reg) == 0);
+    CHECK(chip8.PC == saved[frame].PC && chip8.I == saved[frame].I && chip8.rng == saved[frame].rng);
+
+    CHECK(chip8_rewind_step(&rw, &chip8, 1));
+    frame = 48;
+    CHECK(same_snapshot(&chip8, &saved[frame]));
+
+    // run on from there and go back over the new frames and into the old
+    for (frame++; frame < 110; frame++) {
+        chip8.keyboard[frame % 16] ^= true;
+        chip8_sched_run(&chip8, &sched, CHIP8_CYCLES_PER_FRAME);
+        chip8_rewind_push(&rw, &chip8, frame);
+        saved[frame] = chip8;
+    }
+    CHECK(chip8_rewind_step(&rw, &chip8, 5));
+    CHECK(same_snapshot(&chip8, &saved[104]));
+    CHECK(chip8_rewind_step(&rw, &chip8, 70));
+    CHECK(same_snapshot(&chip8, &saved[34]));
+
+    // clamped to the oldest frame, then nothing left
+    CHECK(chip8_rewind_step(&rw, &chip8, 1000));
+    CHECK(same_snapshot(&chip8, &saved[0]));
+    CHECK(!chip8_rewind_step(&rw, &chip8, 1));
+
+    chip8_rewind_free(&rw);
+}
+
+
+// lanes with their own seeds and keys split on CXNN and EX9E, merge again
+// at 8XY4 and each ends where a machine of its own run on the same seed
+// and keys does
+static void test_lanes_match_single_machines(void) {
+    static const uint16_t code[] = {
+        0xC001,     // 200: V0 = random bit
+        0x3000,
+        0x7105,     // V1 += 5 where it was 1
+        0x6205,
+        0xE29E,     // skip if key 5 is down
+        0x7301,
+        0x8134,     // 20C: all lanes here again, V1 += V3
+        0x8106,     // V1 >>= 1
+        0x8F35,     // VF -= V3, VF both operand and flag
+        0x81F7,     // V1 = VF - V1
+        0x8FFE,     // VF <<= 1
+        0xA300,
+        0xF133,     // BCD of V1 at 300
+        0xF129,
+        0xD235,     // draw digit V1 at V2, V3
+        0xF315,     // DT = V3
+        0x1200,
+    };
+    const int count = 8;
+    const uint64_t cycles = 2000;
+    static chip8_lanes_t lanes;
+    chip8_t base;
+    chip8_sched_t sched;
+
+    load(&base, code, sizeof code / sizeof code[0]);
+    chip8_lanes_init(&lanes, &base, count);
+    for (int l = 0; l < count; l++) {
+        chip8_lanes_seed(&lanes, l, 100 + l);
+        lanes.keys[l] = l % 3 ? 1 << 5 : 0;
+    }
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+    chip8_lanes_run(&lanes, &sched, cycles);
+
+    // split more than never, still far fewer groups than lanes run alone
+    CHECK(lanes.groups > cycles);
+    CHECK(lanes.groups < cycles * count / 2);
+
+    for (int l = 0; l < count; l++) {
+        chip8_t single, lane = base;
+
+        load(&single, code, sizeof code / sizeof code[0]);
+        chip8_seed(&single, 100 + l);
+        single.keyboard[5] = l % 3 != 0;
+        single.skip_idle = false;
+        chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+        chip8_sched_run(&single, &sched, cycles);
+
+        chip8_lanes_get(&lanes, l, &lane);
+        CHECK(same_snapshot(&lane, &single));
+    }
+}
+
+
+// EX9E on a key number past F: a key fault in checked builds, the low
+// nibble's key otherwise, on every core
+static void test_key_past_f(void) {
+    static const uint16_t code[] = {
+        0x6015,     // V0 = 0x15
+        0xE09E,     // 202: skip if key V0 is down
+        0x6101,
+        0x6202,
+    };
+    static chip8_cache_t cache;
+    static chip8_blocks_t blocks;
+
+    for (int core = 0; core < 3; core++) {
+        chip8_t chip8;
+
+        load(&chip8, code, sizeof code / sizeof code[0]);
+        chip8.keyboard[5] = true;
+        if (core == 1) chip8_cache_attach(&chip8, &cache);
+        if (core == 2) chip8_blocks_attach(&chip8, &blocks);
+        chip8_run(&chip8, 3);
+#ifdef CHIP8_CHECKED
+        CHECK(chip8.fault == CHIP8_FAULT_KEY && chip8.PC == 0x202);
+#else
+        CHECK(chip8.V_reg[1] == 0 && chip8.V_reg[2] == 2);
+#endif
+    }
+}
+
+
+static void test_replay_round_trip(void) {
+    static const uint16_t code[] = {
+        0x650F,     // 200: V5 = 0F
+        0xE09E,     // 202: skip if key V0 is down
+        0x120A,
+        0x7301,     // V3 += 1
+        0xC47F,     // V4 = rnd & 7F
+        0x7001,     // 20A: V0 = V0 + 1 & 0F
+        0x8052,
+        0xF329,     // I = digit V3
+        0xD345,     // draw at V3, V4
+        0x1202,
+    };
+    const char *path = "chip8_test_replay.tmp";
+    chip8_t live, replayed;
+    chip8_sched_t sched, fresh;
+    chip8_replay_t record, loaded;
+
+    // keys change between scheduler runs of uneven length, as in the live loop
+    load(&live, code, sizeof code / sizeof code[0]);
+    chip8_set_variant(&live, CHIP8_VARIANT_SCHIP);
+    chip8_sched_init(&sched, CHIP8_DEFAULT_HZ);
+    chip8_replay_init(&record, 1, CHIP8_DEFAULT_HZ);
+    record.variant = CHIP8_VARIANT_SCHIP;
+    for (int i = 0; i < 60; i++) {
+        uint16_t keys = i % 3 ? 0 : 1 << (i * 7 % 16);
+        for (int k = 0; k < 16; k++)
+            live.keyboard[k] = (keys >> k) & 1;
+        chip8_replay_record(&record, sched.cycles, keys);
+        chip8_sched_run(&live, &sched, 37 + i * 13 % 50);
+    }
+    record.cycles = sched.cycles;
+    CHECK(record.count > 20);
+
+    CHECK(chip8_replay_save(&record, path));
+    CHECK(chip8_replay_load(&loaded, path));
+    CHECK(loaded.seed == record.seed && loaded.hz == record.hz && loaded.cycles == record.cycles);
+    CHECK(loaded.variant == record.variant);
+    CHECK(loaded.count == record.count
+          && memcmp(loaded.events, record.events, record.count * sizeof *record.events) == 0);
+
+    load(&replayed, code, sizeof code / sizeof code[0]);
+    chip8_set_variant(&replayed, loaded.variant);
+    chip8_seed(&replayed, loaded.seed);
+    chip8_sched_init(&fresh, loaded.hz);
+    chip8_replay_run(&replayed, &loaded, &fresh, loaded.cycles);
+    CHECK(same_machine(&replayed, &live));
+    CHECK(fresh.cycles == sched.cycles && fresh.frames == sched.frames && fresh.beeps == sched.beeps);
+    chip8_replay_free(&loaded);
+
+    // a newer recording is refused rather than misread
+    FILE *file = fopen(path, "w");
+    CHECK(file != NULL);
+    if (file) {
+        fprintf(file, "chip8-input %d\nseed 1\nhz 700\ncycles 10\nvariant default\n", CHIP8_REPLAY_VERSION + 1);
+        fclose(file);
+        CHECK(!chip8_replay_load(&loaded, path));
+        chip8_replay_free(&loaded);
+    }
+
+    remove(path);
+    chip8_replay_free(&record);
+}
+
+
+// trace straight to a file, no writer thread
+typedef struct {
+    chip8_trace_t trace;    // first, the flush gets the file back from it
+    FILE *file;
+}file_trace_t;
+
+static void flush_to_file(chip8_trace_t *trace) {
+    fwrite(trace->buf, 1, trace->len, ((file_trace_t *)trace)->file);
+    trace->len = 0;
+}
+
+static const uint16_t trace_loop[] = {
+    0x6001,     // 200: V0 = 1
+    0x6102,     // V1 = 2
+    0xA300,     // I = 300
+    0x8014,     // 206: V0 += V1, VF = carry
+    0xF01E,     // I += V0
+    0x7101,     // V1 += 1
+    0x2212,     // call 212
+    0x1206,
+    0x0000,
+    0x7503,     // 212: V5 += 3
+    0x00EE,
+};
+
+// run cycles instructions under a trace, flipping V5 after the first flip_at
+static bool write_trace(const char *path, uint32_t cycles, uint32_t flip_at) {
+    static file_trace_t t;
+    static uint8_t buf[CHIP8_TRACE_BUFFER];
+    const uint8_t header[6] = { 'C', '8', 'T', 'R', CHIP8_TRACE_VERSION, CHIP8_VARIANT_DEFAULT };
+    chip8_t chip8;
+
+    t.file = fopen(path, "wb");
+    if (!t.file) return false;
+    fwrite(header, 1, sizeof header, t.file);
+    chip8_trace_reset(&t.trace);
+    t.trace.buf = buf;
+    t.trace.len = 0;
+    t.trace.flush = flush_to_file;
+
+    load(&chip8, trace_loop, sizeof trace_loop / sizeof trace_loop[0]);
+    chip8.trace = &t.trace;
+    chip8_run(&chip8, flip_at);
+    chip8.V_reg[5] ^= 0x80;
+    chip8_run(&chip8, cycles - flip_at);
+    flush_to_file(&t.trace);
+    return fclose(t.file) == 0;
+}
+
+static void test_trace_diff_finds_divergence(void) {
+    // long enough to fill the buffer a few times over
+    const uint32_t cycles = 1000000, flip_at = 700001;
+    const char *a = "chip8_test_a.tr", *b = "chip8_test_b.tr";
+    char line[256], expect[256];
+    chip8_t ref;
+
+    CHECK(write_trace(a, cycles, cycles));
+    CHECK(write_trace(b, cycles, flip_at));
+
+    FILE *out = tmpfile();
+    CHECK(out != NULL);
+    if (!out) return;
+
+    CHECK(chip8_trace_diff(a, a, out) == 0);
+    CHECK(chip8_trace_diff(a, b, out) == 1);
+    rewind(out);
+    CHECK(fgets(line, sizeof line, out) && strcmp(line, "traces match, 1000000 instructions\n") == 0);
+    snprintf(expect, sizeof expect, "traces diverge at instruction %u: V5\n", flip_at);
+    CHECK(fgets(line, sizeof line, out) && strcmp(line, expect) == 0);
+
+    // the decoded record of the divergent instruction is the machine after it
+    load(&ref, trace_loop, sizeof trace_loop / sizeof trace_loop[0]);
+    ref.skip_idle = false;
+    chip8_run(&ref, flip_at);
+    uint16_t pc = ref.PC;
+    chip8_run(&ref, 1);
+    int n = snprintf(expect, sizeof expect, "  a PC=0x%03X op=%04X I=0x%03X", pc,
+                     ref.ram[pc] << 8 | ref.ram[pc + 1], ref.I);
+    for (int i = 0; i < 16; i++)
+        n += snprintf(expect + n, sizeof expect - n, " %02X", ref.V_reg[i]);
+    snprintf(expect + n, sizeof expect - n, "\n");
+
+    bool found = false;
+    while (fgets(line, sizeof line, out))
+        found |= strcmp(line, expect) == 0;
+    CHECK(found);
+
+    fclose(out);
+    remove(a);
+    remove(b);
+}
+
+
+static void test_prof_calls_past_the_shadow_stack(void) {
+    static chip8_prof_t prof;
+    const int calls = CHIP8_PROF_DEPTH + 4;
+
+    // routine k lives at 0x300 + 0x10 * k, each calls the next from its start
+    memset(&prof, 0, sizeof prof);
+    chip8_prof_op(&prof, 0x200, 0x2300);
+    for (int k = 0; k + 1 < calls; k++)
+        chip8_prof_op(&prof, 0x300 + 0x10 * k, 0x2300 + 0x10 * (k + 1));
+
+    // unwinding the unpushed calls leaves the innermost pushed routine current
+    // and it is charged its own call, the 3 calls and 4 returns past it, and this op
+    for (int k = calls - 1; k >= CHIP8_PROF_DEPTH; k--)
+        chip8_prof_op(&prof, 0x300 + 0x10 * k + 2, 0x00EE);
+    chip8_prof_op(&prof, 0x300 + 0x10 * (CHIP8_PROF_DEPTH - 1) + 4, 0x6000);
+    CHECK(prof.self[0x300 + 0x10 * (CHIP8_PROF_DEPTH - 1)] == 9);
+
+    for (int k = CHIP8_PROF_DEPTH - 1; k >= 0; k--)
+        chip8_prof_op(&prof, 0x300 + 0x10 * k + 6, 0x00EE);
+    chip8_prof_op(&prof, 0x202, 0x6000);
+    CHECK(prof.depth == 0 && prof.overflow == 0);
+    CHECK(prof.self[CHIP8_ROM_ADDR] == 2);
+}
+
+
+int main(void) {
+    test_debug_steps_match_free_run();
+    test_state_v1_loads_as_default();
+    test_state_rejects_bad_sp_and_pc();
+    test_sched_records_beep_per_frame();
+    test_idle_skip_matches_full_run();
+    test_cores_match_interp();
+    test_cache_invalidated_by_ram_writes();
+    test_rewind_restores_frames();
+    test_lanes_match_single_machines();
+    test_key_past_f();
+    test_replay_round_trip();
+    test_trace_diff_finds_divergence();
+    test_prof_calls_past_the_shadow_stack();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all tests passed\n");
+    return EXIT_SUCCESS;
+}
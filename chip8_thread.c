@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "chip8_thread.h"
+#include "chip8_sched.h"
+#include "chip8_prof.h"
+#include "chip8_debug.h"
+
+
+void frame_buffer_init(frame_buffer_t *frames) {
+    memset(frames->screens, 0, sizeof frames->screens);
+    frames->write = 0;
+    SDL_SetAtomicInt(&frames->middle, 1);
+    frames->read = 2;
+}
+
+
+// swap the written buffer with the spare one and flag it as new
+static void frame_buffer_publish(frame_buffer_t *frames) {
+    frames->write = SDL_SetAtomicInt(&frames->middle, frames->write | FRAME_NEW) & 0x3;
+}
+
+
+const chip8_screen_t *frame_buffer_take(frame_buffer_t *frames) {
+    if (!(SDL_GetAtomicInt(&frames->middle) & FRAME_NEW)) return NULL;
+
+    frames->read = SDL_SetAtomicInt(&frames->middle, frames->read) & 0x3;
+    return &frames->screens[frames->read];
+}
+
+
+bool key_queue_push(input_t *input, uint64_t time, uint16_t keys) {
+    int head = SDL_GetAtomicInt(&input->head);
+    if (head - SDL_GetAtomicInt(&input->tail) == KEY_QUEUE_SIZE) return false;
+
+    input->queue[head & (KEY_QUEUE_SIZE - 1)] = (key_event_t){ time, keys };
+    SDL_SetAtomicInt(&input->head, head + 1);
+    return true;
+}
+
+
+// run the core up to host time now, pushing rewind and audio frames as they complete
+static uint64_t advance(emu_thread_t *emu, chip8_sched_t *sched, uint64_t *last, uint64_t now) {
+    if (now <= *last) return 0;
+
+    uint64_t frames = sched->frames;
+    uint64_t ran = chip8_sched_advance(emu->chip8, sched, now - *last, SDL_NS_PER_SECOND);
+    *last = now;
+
+    if (sched->frames != frames) {
+        chip8_rewind_push(&emu->rewind, emu->chip8, sched->frames);
+        if (emu->audio) audio_frames(emu->audio, sched->frames - frames, sched->beeps);
+    }
+    return ran;
+}
+
+
+static void apply_keys(emu_thread_t *emu, uint64_t cycle, uint16_t keys) {
+    for (int i = 0; i < 16; i++)
+        emu->chip8->keyboard[i] = (keys >> i) & 1;
+    if (emu->record) chip8_replay_record(emu->record, cycle, keys);
+}
+
+
+static int emu_thread_main(void *data) {
+    emu_thread_t *emu = data;
+    chip8_t *chip8 = emu->chip8;
+    chip8_sched_t sched;
+
+    chip8_sched_init(&sched, emu->hz);
+
+    input_t *input = emu->input;
+    uint64_t last = SDL_GetTicksNS();
+    uint64_t rewind_acc = 0;    // host ns * 60 towards the next step back
+    bool reported = false;      // debugger stop already printed
+    int state;
+
+    while ((state = SDL_GetAtomicInt(&input->state)) != QUIT) {
+        uint64_t now = SDL_GetTicksNS();
+        bool running = state != PAUSE && !(SDL_GetAtomicInt(&input->rewind) && !emu->record);
+
+        switch (SDL_SetAtomicInt(&input->command, CMD_NONE)) {
+            case CMD_SAVE_STATE:
+                if (chip8_state_save_file(chip8, emu->state_path))
+                    SDL_Log("State saved to %s", emu->state_path);
+                break;
+            case CMD_LOAD_STATE:
+                if (emu->record)
+                    SDL_Log("Loading a state would break the recording, ignored");
+                else if (chip8_state_load_file(chip8, emu->state_path))
+                    SDL_Log("State loaded from %s", emu->state_path);
+                break;
+            case CMD_CONTINUE:
+                if (chip8->debug) chip8_debug_continue(chip8->debug);
+                reported = false;
+                break;
+            case CMD_STEP:
+                if (chip8->debug) chip8_debug_step(chip8->debug, 1);
+                reported = false;
+                break;
+            case CMD_STEP_OVER:
+                if (chip8->debug) chip8_debug_step_over(chip8->debug, chip8);
+                reported = false;
+                break;
+            default:
+                break;
+        }
+
+        uint64_t mark = chip8->prof ? chip8_prof_now() : 0;
+        uint64_t ran = 0;
+
+        // each key change lands on the cycle of its timestamp; events from
+        // before last (queued while paused, or older than the slice already
+        // run) apply at the current cycle
+        int tail = SDL_GetAtomicInt(&input->tail);
+        for (int head = SDL_GetAtomicInt(&input->head); tail != head; tail++) {
+            key_event_t event = input->queue[tail & (KEY_QUEUE_SIZE - 1)];
+            if (running) ran += advance(emu, &sched, &last, SDL_min(event.time, now));
+            apply_keys(emu, sched.cycles, event.keys);
+        }
+        SDL_SetAtomicInt(&input->tail, tail);
+
+        if (state == PAUSE) {
+            last = now;     // paused time is not caught up later
+            SDL_Delay(1);
+            continue;
+        }
+
+        // a recording has to stay one straight run, so no rewinding it
+        if (!running) {
+            rewind_acc += (now - last) * 60;
+            last = now;
+            for (; rewind_acc >= SDL_NS_PER_SECOND; rewind_acc -= SDL_NS_PER_SECOND)
+                chip8_rewind_step(&emu->rewind, chip8, 1);
+        } else {
+            rewind_acc = 0;
+            ran += advance(emu, &sched, &last, now);
+
+            chip8_prof_mark(chip8->prof, PROF_EMULATE, mark);
+            if (chip8->prof) chip8_hist_add(&chip8->prof->cycles, ran);
+        }
+
+        // the register and memory view of a debugger stop goes to stderr once
+        if (chip8_debug_stopped(chip8) && !reported) {
+            chip8_debug_print_state(chip8, stderr);
+            chip8_debug_print_ram(chip8, chip8->I, 16, stderr);
+            reported = true;
+        }
+
+        // only hand over frames that changed something on screen
+        if (chip8->dirty_rows) {
+            chip8_screen(chip8, &emu->frames->screens[emu->frames->write]);
+            frame_buffer_publish(emu->frames);
+            chip8->dirty_rows = 0;
+        }
+
+        // SCHIP 00FD exits the interpreter, take the window down with it
+        if (chip8->state == QUIT) {
+            SDL_SetAtomicInt(&input->state, QUIT);
+            break;
+        }
+
+        mark = chip8->prof ? chip8_prof_now() : 0;
+        SDL_DelayNS(1000000);  // 1ms slices, the scheduler makes up the exact count
+        chip8_prof_mark(chip8->prof, PROF_SLEEP, mark);
+    }
+
+    if (emu->record) emu->record->cycles = sched.cycles;
+
+    return 0;
+}
+
+
+bool emu_thread_start(emu_thread_t *emu) {
+    if (!chip8_rewind_init(&emu->rewind, CHIP8_REWIND_FRAMES, CHIP8_REWIND_ARENA)) return false;
+
+    emu->thread = SDL_CreateThread(emu_thread_main, "chip8", emu);
+    if (emu->thread == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create emulation thread: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+
+void emu_thread_join(emu_thread_t *emu) {
+    SDL_SetAtomicInt(&emu->input->state, QUIT);
+    SDL_WaitThread(emu->thread, NULL);
+    emu->thread = NULL;
+    chip8_rewind_free(&emu->rewind);
+}
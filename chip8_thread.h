@@ -0,0 +1,86 @@
+#ifndef CHIP8_THREAD_H
+#define CHIP8_THREAD_H
+
+#include <SDL3/SDL.h>
+
+#include "chip8_core.h"
+#include "chip8_variant.h"
+#include "chip8_rewind.h"
+#include "chip8_replay.h"
+#include "chip8_audio.h"
+
+
+/* emulation thread
+ * the core runs on its own thread and hands finished displays to the render
+ * thread through a lock-free triple buffer; run state comes back through
+ * atomics, so a blocking present never stalls emulation. key changes travel
+ * through a single producer/single consumer queue stamped with the host
+ * time of the event, and the emulation thread runs the core up to that time
+ * before applying them, so a press lands on the cycle it happened at rather
+ * than at the start of the next 1ms slice.
+ */
+
+#define FRAME_NEW 0x4       // set in middle when the spare buffer holds an unread frame
+#define KEY_QUEUE_SIZE 64   // power of two
+
+// one-shot requests from the render thread
+typedef enum {
+    CMD_NONE,
+    CMD_SAVE_STATE,
+    CMD_LOAD_STATE,
+    CMD_CONTINUE,       // debugger: leave a stop
+    CMD_STEP,           // debugger: one instruction, breaks in when running
+    CMD_STEP_OVER,
+}emu_command_t;
+
+typedef struct {
+    chip8_screen_t screens[3];
+    SDL_AtomicInt middle;   // spare buffer index | FRAME_NEW
+    int write;              // emulation thread only
+    int read;               // render thread only
+}frame_buffer_t;
+
+// whole keypad after a change, so a dropped event is made up by the next
+typedef struct {
+    uint64_t time;          // SDL_GetTicksNS timebase
+    uint16_t keys;          // bit per CHIP8 key
+}key_event_t;
+
+// written by input_handler, read by the emulation thread
+typedef struct {
+    key_event_t queue[KEY_QUEUE_SIZE];
+    SDL_AtomicInt head;     // next write, render thread only
+    SDL_AtomicInt tail;     // next read, emulation thread only
+    uint16_t keys;          // render thread only: current keypad
+    SDL_AtomicInt state;    // emulator_state_t
+    SDL_AtomicInt command;  // emu_command_t, cleared by the emulation thread
+    SDL_AtomicInt rewind;   // held: run history backwards at 60 frames/s
+    bool redraw;            // render thread only: window needs a full redraw
+}input_t;
+
+typedef struct {
+    chip8_t *chip8;
+    uint64_t hz;
+    input_t *input;
+    frame_buffer_t *frames;
+    const char *state_path;     // F5/F9 save state file
+    chip8_rewind_t rewind;      // every frame of the last CHIP8_REWIND_FRAMES
+    chip8_replay_t *record;     // key log, NULL when not recording
+    audio_t *audio;             // beeper, NULL when there is no sound
+    SDL_Thread *thread;
+}emu_thread_t;
+
+
+void frame_buffer_init(frame_buffer_t *frames);
+
+// render thread: queue the keypad as of time, false (event dropped) when full
+bool key_queue_push(input_t *input, uint64_t time, uint16_t keys);
+
+// newest published screen, NULL if nothing new since the last call
+const chip8_screen_t *frame_buffer_take(frame_buffer_t *frames);
+
+
+bool emu_thread_start(emu_thread_t *emu);
+void emu_thread_join(emu_thread_t *emu);
+
+#endif // CHIP8_THREAD_H
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+
+#include <SDL3/SDL.h>
+
+#include "chip8_trace.h"
+
+
+typedef struct {
+    chip8_trace_t trace;    // first, flush gets the writer back from it
+    FILE *file;
+    uint8_t *bufs[2];
+
+    // one buffer handed to the writer at a time
+    SDL_Thread *thread;
+    SDL_Mutex *lock;
+    SDL_Condition *cond;
+    uint8_t *pending;
+    size_t pending_len;
+    bool done;
+    bool failed;        // a write failed, the rest is dropped
+
+    uint64_t bytes;
+    uint64_t stalls;    // flushes that found the writer still busy
+}trace_writer_t;
+
+
+static int writer_main(void *data) {
+    trace_writer_t *w = data;
+
+    SDL_LockMutex(w->lock);
+    for (;;) {
+        while (!w->pending && !w->done)
+            SDL_WaitCondition(w->cond, w->lock);
+        if (!w->pending) break;
+
+        uint8_t *buf = w->pending;
+        size_t len = w->pending_len;
+        SDL_UnlockMutex(w->lock);
+
+        bool ok = w->failed || fwrite(buf, 1, len, w->file) == len;
+
+        SDL_LockMutex(w->lock);
+        if (!ok) w->failed = true;
+        w->pending = NULL;
+        SDL_SignalCondition(w->cond);
+    }
+    SDL_UnlockMutex(w->lock);
+    return 0;
+}
+
+
+// emulation thread: swap buffers, waiting only while the other one is still being written
+static void writer_flush(chip8_trace_t *trace) {
+    trace_writer_t *w = (trace_writer_t *)trace;
+
+    SDL_LockMutex(w->lock);
+    if (w->pending) w->stalls++;
+    while (w->pending)
+        SDL_WaitCondition(w->cond, w->lock);
+
+    w->pending = trace->buf;
+    w->pending_len = trace->len;
+    SDL_SignalCondition(w->cond);
+    SDL_UnlockMutex(w->lock);
+
+    w->bytes += trace->len;
+    trace->buf = trace->buf == w->bufs[0] ? w->bufs[1] : w->bufs[0];
+    trace->len = 0;
+}
+
+
+static void writer_free(trace_writer_t *w) {
+    if (w->file) fclose(w->file);
+    SDL_DestroyCondition(w->cond);
+    SDL_DestroyMutex(w->lock);
+    free(w->bufs[0]);
+    free(w->bufs[1]);
+    free(w);
+}
+
+
+chip8_trace_t *chip8_trace_open(const char *path, chip8_variant_t variant) {
+    trace_writer_t *w = calloc(1, sizeof *w);
+    if (!w) return NULL;
+
+    w->file = fopen(path, "wb");
+    w->bufs[0] = malloc(CHIP8_TRACE_BUFFER);
+    w->bufs[1] = malloc(CHIP8_TRACE_BUFFER);
+    w->lock = SDL_CreateMutex();
+    w->cond = SDL_CreateCondition();
+
+    if (!w->file) CHIP8_LOG("Could not write trace %s", path);
+    if (!w->file || !w->bufs[0] || !w->bufs[1] || !w->lock || !w->cond) {
+        writer_free(w);
+        return NULL;
+    }
+
+    const uint8_t header[6] = { 'C', '8', 'T', 'R', CHIP8_TRACE_VERSION, variant };
+    fwrite(header, 1, sizeof header, w->file);
+
+    chip8_trace_reset(&w->trace);
+    w->trace.buf = w->bufs[0];
+    w->trace.flush = writer_flush;
+
+    w->thread = SDL_CreateThread(writer_main, "chip8 trace", w);
+    if (!w->thread) {
+        CHIP8_LOG("Could not start the trace writer: %s", SDL_GetError());
+        writer_free(w);
+        return NULL;
+    }
+    return &w->trace;
+}
+
+
+void chip8_trace_close(chip8_trace_t *trace) {
+    trace_writer_t *w = (trace_writer_t *)trace;
+
+    writer_flush(trace);
+
+    SDL_LockMutex(w->lock);
+    w->done = true;
+    SDL_SignalCondition(w->cond);
+    SDL_UnlockMutex(w->lock);
+    SDL_WaitThread(w->thread, NULL);
+
+    if (w->failed)
+        CHIP8_LOG("Trace write failed, the file is cut short");
+    else
+        CHIP8_LOG("Traced %llu instructions, %llu bytes, writer stalled %llu times",
+                  (unsigned long long)trace->count, (unsigned long long)w->bytes + 6,
+                  (unsigned long long)w->stalls);
+    writer_free(w);
+}
@@ -0,0 +1,136 @@
+#ifndef CHIP8_TRACE_H
+#define CHIP8_TRACE_H
+
+#include <string.h>
+
+#include "chip8_core.h"
+
+
+/* execution trace
+ * one record per executed instruction, delta encoded against the previous
+ * one: a flags byte, then only what changed - PC when it didn't follow on,
+ * the opcode when it isn't the one last run at that address, I, and the
+ * V registers that changed. a straight-line op touching one register is 3
+ * bytes. records fill one of two buffers while a writer thread writes the
+ * other out, so the core only waits if the disk falls behind.
+ * file: "C8TR", version byte, variant byte, then records. the threaded
+ * writer is chip8_trace.c (SDL), the reader and diff chip8_trace_diff.c
+ * (stdio only); any flush that appends buf to such a file will do.
+ * while a trace is attached chip8_run steps the interpreter and skips no
+ * wait loops, so every instruction shows up; detached it costs nothing.
+ */
+
+#define CHIP8_TRACE_MAGIC "C8TR"
+#define CHIP8_TRACE_VERSION 1
+#define CHIP8_TRACE_BUFFER (1 << 20)    // bytes per buffer
+#define CHIP8_TRACE_MAX_RECORD (1 + 2 + 2 + 2 + 2 + 16)
+
+// record flags, the fields follow in this order
+enum {
+    CHIP8_TRACE_PC = 1 << 0,    // u16 PC, not the last one + 2
+    CHIP8_TRACE_OP = 1 << 1,    // u16 opcode, not the one last run at PC
+    CHIP8_TRACE_I = 1 << 2,     // u16 I
+    CHIP8_TRACE_V1 = 1 << 3,    // one register changed: index, value
+    CHIP8_TRACE_VN = 1 << 4,    // several: u16 mask, then a value per bit
+};
+
+typedef struct chip8_trace chip8_trace_t;
+
+// encoder state, the reader keeps the same to decode
+struct chip8_trace {
+    uint8_t *buf;       // CHIP8_TRACE_BUFFER bytes
+    size_t len;
+    void (*flush)(chip8_trace_t *trace);    // hand buf over, leaves an empty one
+    uint64_t count;     // instructions traced
+    uint16_t pc;        // last traced PC
+    uint16_t I;
+    uint8_t V[16];
+    uint16_t ops[CHIP8_RAM_SIZE];   // last opcode traced at each address
+};
+
+
+// start a trace file with its writer thread, NULL on failure
+chip8_trace_t *chip8_trace_open(const char *path, chip8_variant_t variant);
+
+// write out what is buffered, stop the writer and close the file
+void chip8_trace_close(chip8_trace_t *trace);
+
+// compare two trace files record by record and report the first divergence
+// with the instructions leading up to it. 0 same, 1 different, -1 unreadable
+int chip8_trace_diff(const char *path_a, const char *path_b, FILE *out);
+
+
+// decoder and encoder start from a fresh machine
+static inline void chip8_trace_reset(chip8_trace_t *trace) {
+    trace->count = 0;
+    trace->pc = CHIP8_ROM_ADDR - 2;
+    trace->I = 0;
+    memset(trace->V, 0, sizeof trace->V);
+    memset(trace->ops, 0, sizeof trace->ops);
+}
+
+static inline uint8_t *chip8_trace_put16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+// record the instruction just run from pc, chip8 holds its results
+static inline void chip8_trace_op(chip8_trace_t *trace, const chip8_t *chip8, uint16_t pc) {
+    if (trace->len > CHIP8_TRACE_BUFFER - CHIP8_TRACE_MAX_RECORD)
+        trace->flush(trace);
+
+    uint8_t *head = trace->buf + trace->len;
+    uint8_t *p = head + 1;
+    uint8_t flags = 0;
+
+    if (pc != (uint16_t)(trace->pc + 2)) {
+        flags |= CHIP8_TRACE_PC;
+        p = chip8_trace_put16(p, pc);
+    }
+    trace->pc = pc;
+
+    uint16_t opcode = chip8->instruction.opcode;
+    uint16_t *seen = &trace->ops[pc & (CHIP8_RAM_SIZE - 1)];
+    if (*seen != opcode) {
+        flags |= CHIP8_TRACE_OP;
+        p = chip8_trace_put16(p, opcode);
+        *seen = opcode;
+    }
+
+    if (chip8->I != trace->I) {
+        flags |= CHIP8_TRACE_I;
+        p = chip8_trace_put16(p, chip8->I);
+        trace->I = chip8->I;
+    }
+
+    // most ops leave the registers alone, two word compares tell
+    uint64_t now[2], was[2];
+    memcpy(now, chip8->V_reg, sizeof now);
+    memcpy(was, trace->V, sizeof was);
+
+    if ((now[0] ^ was[0]) | (now[1] ^ was[1])) {
+        uint16_t mask = 0;
+        for (int i = 0; i < 16; i++)
+            mask |= (uint16_t)(chip8->V_reg[i] != trace->V[i]) << i;
+
+        if (!(mask & (mask - 1))) {
+            int i = __builtin_ctz(mask);
+            flags |= CHIP8_TRACE_V1;
+            *p++ = i;
+            *p++ = chip8->V_reg[i];
+        } else {
+            flags |= CHIP8_TRACE_VN;
+            p = chip8_trace_put16(p, mask);
+            for (int i = 0; i < 16; i++)
+                if (mask & (1u << i)) *p++ = chip8->V_reg[i];
+        }
+        memcpy(trace->V, chip8->V_reg, sizeof trace->V);
+    }
+
+    *head = flags;
+    trace->len = p - trace->buf;
+    trace->count++;
+}
+
+#endif // CHIP8_TRACE_H
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+
+#include "chip8_trace.h"
+#include "chip8_variant.h"
+
+
+#define DIFF_CONTEXT 8      // instructions shown before a divergence
+#define READ_BUFFER (1 << 16)
+
+
+// decoder: the encoder's state plus the opcode of the current record
+typedef struct {
+    chip8_trace_t state;
+    uint16_t opcode;
+    FILE *file;
+    const char *path;
+    uint8_t variant;
+    uint8_t buf[READ_BUFFER];
+    size_t pos;
+    size_t len;
+}trace_reader_t;
+
+
+static bool fill(trace_reader_t *r, size_t need) {
+    if (r->len - r->pos >= need) return true;
+
+    memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+    r->len -= r->pos;
+    r->pos = 0;
+    r->len += fread(r->buf + r->len, 1, sizeof r->buf - r->len, r->file);
+    return r->len >= need;
+}
+
+static uint16_t get16(trace_reader_t *r) {
+    uint16_t v = r->buf[r->pos] | r->buf[r->pos + 1] << 8;
+    r->pos += 2;
+    return v;
+}
+
+
+static bool reader_open(trace_reader_t *r, const char *path) {
+    r->path = path;
+    r->pos = r->len = 0;
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        CHIP8_LOG("Trace %s not found", path);
+        return false;
+    }
+
+    if (!fill(r, 6) || memcmp(r->buf, CHIP8_TRACE_MAGIC, 4) != 0 || r->buf[4] != CHIP8_TRACE_VERSION
+        || r->buf[5] >= CHIP8_VARIANT_COUNT) {
+        CHIP8_LOG("%s is not a version %d trace", path, CHIP8_TRACE_VERSION);
+        fclose(r->file);
+        return false;
+    }
+
+    r->variant = r->buf[5];
+    r->pos = 6;
+    chip8_trace_reset(&r->state);
+    return true;
+}
+
+
+// next record, false at the end of the file (or a truncated record)
+static bool reader_next(trace_reader_t *r) {
+    chip8_trace_t *s = &r->state;
+
+    if (!fill(r, CHIP8_TRACE_MAX_RECORD) && r->pos == r->len) return false;
+
+    size_t start = r->pos;
+    uint8_t flags = r->buf[r->pos++];
+    size_t need = (flags & CHIP8_TRACE_PC ? 2 : 0) + (flags & CHIP8_TRACE_OP ? 2 : 0)
+                + (flags & CHIP8_TRACE_I ? 2 : 0) + (flags & CHIP8_TRACE_V1 ? 2 : 0)
+                + (flags & CHIP8_TRACE_VN ? 2 : 0);
+    if (r->len - r->pos < need) goto truncated;
+
+    s->pc = flags & CHIP8_TRACE_PC ? get16(r) : (uint16_t)(s->pc + 2);
+
+    uint16_t *seen = &s->ops[s->pc & (CHIP8_RAM_SIZE - 1)];
+    if (flags & CHIP8_TRACE_OP) *seen = get16(r);
+    r->opcode = *seen;
+
+    if (flags & CHIP8_TRACE_I) s->I = get16(r);
+
+    if (flags & CHIP8_TRACE_V1) {
+        uint8_t i = r->buf[r->pos++] & 0xF;
+        s->V[i] = r->buf[r->pos++];
+    }
+
+    if (flags & CHIP8_TRACE_VN) {
+        uint16_t mask = get16(r);
+        if (r->len - r->pos < (size_t)__builtin_popcount(mask)) goto truncated;
+        for (int i = 0; i < 16; i++)
+            if (mask & (1u << i)) s->V[i] = r->buf[r->pos++];
+    }
+
+    s->count++;
+    return true;
+
+truncated:
+    CHIP8_LOG("%s: truncated record at byte %zu", r->path, start);
+    return false;
+}
+
+
+static void print_record(FILE *out, const char *label, const trace_reader_t *r) {
+    const chip8_trace_t *s = &r->state;
+
+    fprintf(out, "  %s PC=0x%03X op=%04X I=0x%03X", label, s->pc, r->opcode, s->I);
+    for (int i = 0; i < 16; i++)
+        fprintf(out, " %02X", s->V[i]);
+    fputc('\n', out);
+}
+
+
+int chip8_trace_diff(const char *path_a, const char *path_b, FILE *out) {
+    trace_reader_t *a = malloc(sizeof *a);
+    trace_reader_t *b = malloc(sizeof *b);
+    int result = -1;
+
+    if (!a || !b || !reader_open(a, path_a)) goto done;
+    if (!reader_open(b, path_b)) {
+        fclose(a->file);
+        goto done;
+    }
+
+    if (a->variant != b->variant)
+        fprintf(out, "variants differ: %s vs %s\n", chip8_variant_names[a->variant], chip8_variant_names[b->variant]);
+
+    // the instructions both ran before the current one
+    struct { uint16_t pc, opcode; } context[DIFF_CONTEXT];
+
+    for (;;) {
+        bool more_a = reader_next(a);
+        bool more_b = reader_next(b);
+
+        if (!more_a || !more_b) {
+            if (more_a == more_b) {
+                fprintf(out, "traces match, %llu instructions\n", (unsigned long long)a->state.count);
+                result = 0;
+            } else {
+                const trace_reader_t *longer = more_a ? a : b;
+                fprintf(out, "%s ends after %llu instructions, %s goes on:\n", more_a ? path_b : path_a,
+                        (unsigned long long)longer->state.count - 1, longer->path);
+                print_record(out, more_a ? "a" : "b", longer);
+                result = 1;
+            }
+            break;
+        }
+
+        const chip8_trace_t *sa = &a->state, *sb = &b->state;
+        if (sa->pc != sb->pc || a->opcode != b->opcode || sa->I != sb->I || memcmp(sa->V, sb->V, sizeof sa->V) != 0) {
+            uint64_t n = sa->count - 1;
+            fprintf(out, "traces diverge at instruction %llu:", (unsigned long long)n);
+
+            if (sa->pc != sb->pc) fprintf(out, " PC");
+            else if (a->opcode != b->opcode) fprintf(out, " opcode");
+            if (sa->I != sb->I) fprintf(out, " I");
+            for (int i = 0; i < 16; i++)
+                if (sa->V[i] != sb->V[i]) fprintf(out, " V%X", i);
+            fputc('\n', out);
+
+            uint64_t shown = n < DIFF_CONTEXT ? n : DIFF_CONTEXT;
+            for (uint64_t k = n - shown; k < n; k++)
+                fprintf(out, "  %8llu PC=0x%03X op=%04X\n", (unsigned long long)k,
+                        context[k % DIFF_CONTEXT].pc, context[k % DIFF_CONTEXT].opcode);
+
+            print_record(out, "a", a);
+            print_record(out, "b", b);
+            result = 1;
+            break;
+        }
+
+        context[(sa->count - 1) % DIFF_CONTEXT].pc = sa->pc;
+        context[(sa->count - 1) % DIFF_CONTEXT].opcode = a->opcode;
+    }
+
+    fclose(a->file);
+    fclose(b->file);
+done:
+    free(a);
+    free(b);
+    return result;
+}
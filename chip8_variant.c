@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include "chip8_variant.h"
+
+
+#define QUIRKS(name, id, ...) [id] = { __VA_ARGS__ },
+const chip8_quirks_t chip8_quirks[CHIP8_VARIANT_COUNT] = { CHIP8_VARIANTS(QUIRKS) };
+
+#define NAME(name, id, ...) [id] = #name,
+const char *const chip8_variant_names[CHIP8_VARIANT_COUNT] = { CHIP8_VARIANTS(NAME) };
+
+
+// SCHIP 8x10 digits 0-9, XO-CHIP adds A-F
+static const uint8_t big_font[16 * 10] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x18, 0x3C, 0x66, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+    0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0, // F
+};
+
+
+bool chip8_variant_parse(const char *name, chip8_variant_t *variant) {
+    for (int i = 0; i < CHIP8_VARIANT_COUNT; i++) {
+        if (strcmp(name, chip8_variant_names[i]) == 0) {
+            *variant = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void chip8_set_variant(chip8_t *chip8, chip8_variant_t variant) {
+    chip8->variant = variant;
+    chip8_set_hires(chip8, false);
+
+    // the default machine's ram stays as it always was, hashes included
+    if (chip8_quirks[variant].schip)
+        memcpy(&chip8->ram[CHIP8_BIG_FONT_ADDR], big_font, sizeof big_font);
+
+    // decoded handlers belong to the old variant
+    chip8_ram_written(chip8, 0, CHIP8_RAM_SIZE);
+}
+
+
+void chip8_set_hires(chip8_t *chip8, bool hires) {
+    chip8->hires = hires;
+    memset(chip8->display, 0, sizeof chip8->display);
+    memset(chip8->hires_display, 0, sizeof chip8->hires_display);
+    chip8->dirty_rows = ~0u;
+}
+
+
+void chip8_clear(chip8_t *chip8) {
+    if (chip8->hires)
+        memset(chip8->hires_display, 0, sizeof chip8->hires_display);
+    else
+        memset(chip8->display, 0, sizeof chip8->display);
+    chip8->dirty_rows = ~0u;
+}
+
+
+// one 128 column row shifted right by dx (left when negative), zeros shifted in
+static void shift_row(uint64_t row[2], int dx) {
+    if (dx > 0) {
+        row[1] = (row[1] >> dx) | (row[0] << (64 - dx));
+        row[0] >>= dx;
+    } else if (dx < 0) {
+        row[0] = (row[0] << -dx) | (row[1] >> (64 + dx));
+        row[1] <<= -dx;
+    }
+}
+
+
+void chip8_scroll(chip8_t *chip8, int dy, int dx) {
+    if (chip8->hires) {
+        uint64_t (*rows)[2] = chip8->hires_display;
+
+        if (dy > 0) {
+            memmove(rows[dy], rows[0], (CHIP8_HIRES_HEIGHT - dy) * sizeof rows[0]);
+            memset(rows[0], 0, dy * sizeof rows[0]);
+        } else if (dy < 0) {
+            memmove(rows[0], rows[-dy], (CHIP8_HIRES_HEIGHT + dy) * sizeof rows[0]);
+            memset(rows[CHIP8_HIRES_HEIGHT + dy], 0, -dy * sizeof rows[0]);
+        }
+
+        for (int y = 0; dx && y < CHIP8_HIRES_HEIGHT; y++)
+            shift_row(rows[y], dx);
+    } else {
+        uint64_t *rows = chip8->display;
+        if (dy > CHIP8_HEIGHT) dy = CHIP8_HEIGHT;
+        if (dy < -CHIP8_HEIGHT) dy = -CHIP8_HEIGHT;
+
+        if (dy > 0) {
+            memmove(&rows[dy], &rows[0], (CHIP8_HEIGHT - dy) * sizeof rows[0]);
+            memset(&rows[0], 0, dy * sizeof rows[0]);
+        } else if (dy < 0) {
+            memmove(&rows[0], &rows[-dy], (CHIP8_HEIGHT + dy) * sizeof rows[0]);
+            memset(&rows[CHIP8_HEIGHT + dy], 0, -dy * sizeof rows[0]);
+        }
+
+        for (int y = 0; dx && y < CHIP8_HEIGHT; y++)
+            rows[y] = dx > 0 ? rows[y] >> dx : rows[y] << -dx;
+    }
+
+    chip8->dirty_rows = ~0u;
+}
+
+
+// 32 bits spread to 64, each bit doubled
+static uint64_t double_bits(uint32_t half) {
+    uint64_t x = half;
+    x = (x | x << 16) & 0x0000FFFF0000FFFFull;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFull;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | x << 2) & 0x3333333333333333ull;
+    x = (x | x << 1) & 0x5555555555555555ull;
+    return x | x << 1;
+}
+
+
+void chip8_screen(const chip8_t *chip8, chip8_screen_t *screen) {
+    if (chip8->hires) {
+        memcpy(screen->rows, chip8->hires_display, sizeof screen->rows);
+        return;
+    }
+
+    for (int y = 0; y < CHIP8_HEIGHT; y++) {
+        uint64_t left = double_bits(chip8->display[y] >> 32);
+        uint64_t right = double_bits(chip8->display[y] & 0xFFFFFFFF);
+
+        screen->rows[2 * y][0] = screen->rows[2 * y + 1][0] = left;
+        screen->rows[2 * y][1] = screen->rows[2 * y + 1][1] = right;
+    }
+}
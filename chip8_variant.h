@@ -0,0 +1,205 @@
+#ifndef CHIP8_VARIANT_H
+#define CHIP8_VARIANT_H
+
+#include "chip8_core.h"
+
+
+/* variants and quirk profiles
+ * each variant fixes how the ambiguous opcodes behave as a compile-time
+ * chip8_quirks_t. the interpreter loop is instantiated once per variant
+ * from CHIP8_VARIANTS and the handler cores pick per-variant handlers when
+ * they decode, so no quirk is tested while instructions run. the helpers
+ * below are always inlined with a constant quirks argument for that reason.
+ *
+ * default  the behaviour this emulator always had: shifts in place, FX55/FX65
+ *          leave I alone, BNNN + V0, sprites wrap
+ * cosmac   COSMAC VIP: 8XY1/2/3 reset VF, shifts read VY, FX55/FX65 advance I,
+ *          sprites clip
+ * schip    SUPER-CHIP 1.1: 128x64 mode, scrolling, 16x16 sprites, big font,
+ *          user flags, BXNN + VX, sprites clip
+ * xochip   XO-CHIP on one bitplane and 4K of ram: schip's display plus 00DN,
+ *          5XY2/5XY3, F000 NNNN (skips step over it), shifts read VY, FX55/FX65
+ *          advance I, sprites wrap. FX01/FX02/FX3A are accepted and ignored
+ */
+
+typedef struct {
+    bool vf_reset;      // 8XY1/8XY2/8XY3 clear VF
+    bool shift_vy;      // 8XY6/8XYE shift VY into VX instead of VX in place
+    bool mem_inc;       // FX55/FX65 leave I past the last register
+    bool jump_vx;       // BXNN jumps to XNN + VX instead of NNN + V0
+    bool clip;          // sprites are cut at the screen edges instead of wrapping
+    bool schip;         // SCHIP display and flag instructions
+    bool xochip;        // XO-CHIP instructions
+}chip8_quirks_t;
+
+// X(name, enum, quirks...) for every variant, the quirks as the initializer
+// list of a chip8_quirks_t: plain braces make a constant for static tables,
+// CHIP8_QUIRKS a value for code
+#define CHIP8_VARIANTS(X) \
+    X(default, CHIP8_VARIANT_DEFAULT, 0) \
+    X(cosmac, CHIP8_VARIANT_COSMAC, .vf_reset = true, .shift_vy = true, .mem_inc = true, .clip = true) \
+    X(schip, CHIP8_VARIANT_SCHIP, .jump_vx = true, .clip = true, .schip = true) \
+    X(xochip, CHIP8_VARIANT_XOCHIP, .shift_vy = true, .mem_inc = true, .schip = true, .xochip = true)
+
+#define CHIP8_QUIRKS(...) ((chip8_quirks_t){ __VA_ARGS__ })
+
+#define CHIP8_INLINE static inline __attribute__((always_inline))
+
+// what a frontend shows: the lores display doubled, or the hires plane
+typedef struct {
+    uint64_t rows[CHIP8_HIRES_HEIGHT][2];
+}chip8_screen_t;
+
+extern const chip8_quirks_t chip8_quirks[CHIP8_VARIANT_COUNT];
+extern const char *const chip8_variant_names[CHIP8_VARIANT_COUNT];
+
+
+// variant by name, false if there is none
+bool chip8_variant_parse(const char *name, chip8_variant_t *variant);
+
+// switch instruction set / quirks, call after loading; drops decoded code
+// and the display, loads the big font for SCHIP and XO-CHIP
+void chip8_set_variant(chip8_t *chip8, chip8_variant_t variant);
+
+// current display at 128x64, lores pixels doubled
+void chip8_screen(const chip8_t *chip8, chip8_screen_t *screen);
+
+// 00CN / 00DN / 00FB / 00FC: scroll the current plane by dy rows, dx columns
+void chip8_scroll(chip8_t *chip8, int dy, int dx);
+
+// 00FE / 00FF: switch resolution, both planes are cleared
+void chip8_set_hires(chip8_t *chip8, bool hires);
+
+// 00E0 with a hires plane
+void chip8_clear(chip8_t *chip8);
+
+
+// skip the next instruction; on XO-CHIP that may be the 4 byte F000 NNNN
+CHIP8_INLINE void chip8_skip(chip8_t *chip8, const chip8_quirks_t q) {
+    chip8->PC += 2;
+    if (q.xochip && chip8->ram[(chip8->PC - 2) & (CHIP8_RAM_SIZE - 1)] == 0xF0
+                 && chip8->ram[(chip8->PC - 1) & (CHIP8_RAM_SIZE - 1)] == 0x00)
+        chip8->PC += 2;
+}
+
+// 8XY1 / 8XY2 / 8XY3 after the logic op
+CHIP8_INLINE void chip8_logic_vf(chip8_t *chip8, const chip8_quirks_t q) {
+    if (q.vf_reset) chip8->V_reg[0xF] = 0;
+}
+
+// 8XY6, in place the flag is written first like the default core always did
+CHIP8_INLINE void chip8_shr(chip8_t *chip8, uint8_t X, uint8_t Y, const chip8_quirks_t q) {
+    uint8_t *V = chip8->V_reg;
+    if (q.shift_vy) {
+        uint8_t src = V[Y];
+        V[X] = src >> 1;
+        V[0xF] = src & 0x1;
+    } else {
+        V[0xF] = V[X] & 0x1;
+        V[X] >>= 1;
+    }
+}
+
+// 8XYE
+CHIP8_INLINE void chip8_shl(chip8_t *chip8, uint8_t X, uint8_t Y, const chip8_quirks_t q) {
+    uint8_t *V = chip8->V_reg;
+    if (q.shift_vy) {
+        uint8_t src = V[Y];
+        V[X] = src << 1;
+        V[0xF] = src >> 7;
+    } else {
+        V[0xF] = (V[X] & 0x80) >> 7;
+        V[X] <<= 1;
+    }
+}
+
+// BNNN / BXNN
+CHIP8_INLINE void chip8_jump_offset(chip8_t *chip8, uint16_t NNN, const chip8_quirks_t q) {
+    chip8->PC = NNN + chip8->V_reg[q.jump_vx ? NNN >> 8 : 0];
+}
+
+// FX55
+CHIP8_INLINE void chip8_store(chip8_t *chip8, uint8_t X, const chip8_quirks_t q) {
+    CHIP8_CHECK_RAM(chip8, chip8->I, X + 1);
+    for (int i = 0; i <= X; i++)
+        chip8->ram[chip8->I + i] = chip8->V_reg[i];
+    chip8_ram_written(chip8, chip8->I, X + 1);
+    if (q.mem_inc) chip8->I = (chip8->I + X + 1) & (CHIP8_RAM_SIZE - 1);  // 12 bit like the VIP
+}
+
+// FX65
+CHIP8_INLINE void chip8_load_regs(chip8_t *chip8, uint8_t X, const chip8_quirks_t q) {
+    CHIP8_CHECK_RAM(chip8, chip8->I, X + 1);
+    for (int i = 0; i <= X; i++)
+        chip8->V_reg[i] = chip8->ram[chip8->I + i];
+    if (q.mem_inc) chip8->I = (chip8->I + X + 1) & (CHIP8_RAM_SIZE - 1);
+}
+
+
+// v's bit 63 moved to column s of a 64 column word, cut off outside it
+CHIP8_INLINE uint64_t chip8_place(uint64_t v, int s) {
+    if (s >= 64 || s <= -64) return 0;
+    return s >= 0 ? v >> s : v << -s;
+}
+
+// DXYN for variants other than default, whose lores draw stays in the cores.
+// DXY0 is a 16x16 sprite on SCHIP/XO-CHIP, in either resolution
+CHIP8_INLINE void chip8_draw(chip8_t *chip8, uint8_t X, uint8_t Y, uint8_t N, const chip8_quirks_t q) {
+    uint8_t *V = chip8->V_reg;
+    const bool wide = q.schip && N == 0;
+    const int height = wide ? 16 : N;
+    const int shift = wide ? 48 : 56;
+
+    CHIP8_CHECK_RAM(chip8, chip8->I, wide ? 32 : N);   // clipped rows included
+    V[0xF] = 0;
+
+    if (q.schip && chip8->hires) {
+        int x = V[X] % CHIP8_HIRES_WIDTH;
+        int y = V[Y] % CHIP8_HIRES_HEIGHT;
+
+        for (int row = 0; row < height; row++) {
+            int py = y + row;
+            if (py >= CHIP8_HIRES_HEIGHT) {
+                if (q.clip) break;
+                py -= CHIP8_HIRES_HEIGHT;
+            }
+
+            uint16_t addr = chip8->I + (wide ? 2 * row : row);
+            uint64_t v = (uint64_t)(wide ? chip8->ram[addr] << 8 | chip8->ram[addr + 1] : chip8->ram[addr]) << shift;
+            uint64_t *line = chip8->hires_display[py];
+
+            for (int w = 0; w < 2; w++) {
+                uint64_t bits = chip8_place(v, x - 64 * w);
+                if (!q.clip) bits |= chip8_place(v, x - 128 - 64 * w);
+
+                if (line[w] & bits) V[0xF] = 1;
+                line[w] ^= bits;
+            }
+            chip8->dirty_rows |= 1u << (py / 2);
+        }
+        return;
+    }
+
+    int x = V[X] % CHIP8_WIDTH;
+    int y = V[Y] % CHIP8_HEIGHT;
+
+    for (int row = 0; row < height; row++) {
+        int py = y + row;
+        if (py >= CHIP8_HEIGHT) {
+            if (q.clip) break;
+            py -= CHIP8_HEIGHT;
+        }
+
+        uint16_t addr = chip8->I + (wide ? 2 * row : row);
+        uint64_t v = (uint64_t)(wide ? chip8->ram[addr] << 8 | chip8->ram[addr + 1] : chip8->ram[addr]) << shift;
+        uint64_t bits = chip8_place(v, x);
+        if (!q.clip) bits |= chip8_place(v, x - 64);
+
+        uint64_t *line = &chip8->display[py];
+        if (*line & bits) V[0xF] = 1;
+        *line ^= bits;
+        chip8->dirty_rows |= 1u << py;
+    }
+}
+
+#endif // CHIP8_VARIANT_H
@@ -0,0 +1,153 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_video.h"
+
+
+bool video_init(video_t *video, SDL_Renderer *renderer, const video_filter_t *filter) {
+    video->renderer = renderer;
+    video->fading = false;
+    video->factor = 0;
+    video->scale = NULL;
+    video->texture = NULL;
+    memset(&video->screen, 0, sizeof video->screen);
+
+    // letterbox around the screen
+    SDL_SetRenderDrawColor(renderer, BACKGROUND_COLOR >> 16, BACKGROUND_COLOR >> 8 & 0xFF, BACKGROUND_COLOR & 0xFF, 255);
+
+    if (filter->soft || filter->phosphor || filter->scanlines) {
+        video->scale = aligned_alloc(32, sizeof *video->scale);
+        if (video->scale == NULL) return false;
+
+        chip8_scale_init(video->scale, chip8_scale_best(), filter->phosphor, filter->scanlines,
+                         BACKGROUND_COLOR, PIXEL_COLOR);
+        SDL_Log("Software scaling with %s kernels", chip8_scale_kernel_names[video->scale->kernel]);
+        return true;    // the texture follows the output size, made on the first render
+    }
+
+    video->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_XRGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                       CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT);
+    if (video->texture == NULL) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create texture: %s\n", SDL_GetError());
+        return false;
+    }
+
+    // keep pixels square when scaling up
+    SDL_SetTextureScaleMode(video->texture, SDL_SCALEMODE_NEAREST);
+    return true;
+}
+
+
+// largest whole factor (up to max) the output fits, and where that lands centered
+static int fit(SDL_Renderer *renderer, int max, SDL_FRect *dst) {
+    int w, h;
+    if (!SDL_GetCurrentRenderOutputSize(renderer, &w, &h)) w = h = 0;
+
+    int factor = SDL_min(w / CHIP8_HIRES_WIDTH, h / CHIP8_HIRES_HEIGHT);
+    factor = SDL_clamp(factor, 1, max);
+
+    // whole pixels, so nearest scaling and 1:1 copies stay sharp
+    dst->x = (w - CHIP8_HIRES_WIDTH * factor) / 2;
+    dst->y = (h - CHIP8_HIRES_HEIGHT * factor) / 2;
+    dst->w = CHIP8_HIRES_WIDTH * factor;
+    dst->h = CHIP8_HIRES_HEIGHT * factor;
+    return factor;
+}
+
+
+static void present(video_t *video, const SDL_FRect *dst) {
+    SDL_RenderClear(video->renderer);
+    SDL_RenderTexture(video->renderer, video->texture, NULL, dst);
+    SDL_RenderPresent(video->renderer);
+}
+
+
+// the scaler works out the changed rows itself, fading ones included
+static void render_soft(video_t *video, const chip8_screen_t *screen, bool redraw) {
+    SDL_FRect dst;
+    int factor = fit(video->renderer, CHIP8_SCALE_MAX_FACTOR, &dst);
+
+    if (factor != video->factor) {
+        if (video->texture) SDL_DestroyTexture(video->texture);
+        video->factor = 0;
+        video->texture = SDL_CreateTexture(video->renderer, SDL_PIXELFORMAT_XRGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                           CHIP8_HIRES_WIDTH * factor, CHIP8_HIRES_HEIGHT * factor);
+        if (video->texture == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create texture: %s\n", SDL_GetError());
+            return;
+        }
+        video->factor = factor;
+        redraw = true;
+    }
+
+    uint64_t dirty = chip8_scale_update(video->scale, screen);
+    video->fading = dirty && video->scale->decay;
+    if (redraw) dirty = ~0ull;
+
+    if (dirty == 0) return;
+
+    int top = __builtin_ctzll(dirty);
+    int bottom = 63 - __builtin_clzll(dirty);
+
+    // a locked rect comes back undefined, every row of it is written
+    SDL_Rect rect = { 0, top * factor, CHIP8_HIRES_WIDTH * factor, (bottom - top + 1) * factor };
+    void *pixels;
+    int pitch;
+    if (!SDL_LockTexture(video->texture, &rect, &pixels, &pitch)) return;
+    chip8_scale_rows(video->scale, factor, top, bottom, pixels, pitch);
+    SDL_UnlockTexture(video->texture);
+
+    present(video, &dst);
+}
+
+
+void video_render(video_t *video, const chip8_screen_t *screen, bool redraw) {
+    if (video->scale) {
+        render_soft(video, screen, redraw);
+        return;
+    }
+
+    uint64_t dirty = redraw ? ~0ull : 0;
+
+    // frames may be skipped between renders, so diff against what was uploaded
+    for (int y = 0; y < CHIP8_HIRES_HEIGHT; y++)
+        if (screen->rows[y][0] != video->screen.rows[y][0] || screen->rows[y][1] != video->screen.rows[y][1])
+            dirty |= 1ull << y;
+
+    if (dirty == 0) return;     // idle frame, keep what is on screen
+
+    int top = __builtin_ctzll(dirty);
+    int bottom = 63 - __builtin_clzll(dirty);
+
+    for (int y = top; y <= bottom; y++) {
+        if (!(dirty & (1ull << y))) continue;
+
+        uint32_t *dst = &video->pixels[y * CHIP8_HIRES_WIDTH];
+        video->screen.rows[y][0] = screen->rows[y][0];
+        video->screen.rows[y][1] = screen->rows[y][1];
+
+        for (int w = 0; w < 2; w++) {
+            uint64_t row = screen->rows[y][w];
+            for (int x = 0; x < 64; x++, row <<= 1)
+                dst[64 * w + x] = (row >> 63) ? PIXEL_COLOR : BACKGROUND_COLOR;
+        }
+    }
+
+    // streaming textures can't be read back, so re-upload from our copy
+    SDL_Rect rect = { 0, top, CHIP8_HIRES_WIDTH, bottom - top + 1 };
+    SDL_UpdateTexture(video->texture, &rect, &video->pixels[top * CHIP8_HIRES_WIDTH],
+                      CHIP8_HIRES_WIDTH * sizeof(uint32_t));
+
+    SDL_FRect dst;
+    fit(video->renderer, INT_MAX, &dst);
+    present(video, &dst);
+}
+
+
+void video_destroy(video_t *video) {
+    if (video->texture) SDL_DestroyTexture(video->texture);
+    video->texture = NULL;
+    free(video->scale);
+    video->scale = NULL;
+}
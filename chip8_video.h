@@ -0,0 +1,47 @@
+#ifndef CHIP8_VIDEO_H
+#define CHIP8_VIDEO_H
+
+#include <SDL3/SDL.h>
+
+#include "chip8_core.h"
+#include "chip8_variant.h"
+#include "chip8_scale.h"
+
+
+/* default colors: background 0x000000
+                   pixel 0xffffff
+                   */
+
+#define BACKGROUND_COLOR 0x000000
+#define PIXEL_COLOR 0xcdf7f6
+
+
+// all zero: the renderer scales, no effects
+typedef struct {
+    bool soft;          // scale on the cpu (chip8_scale), implied by either effect
+    int phosphor;       // percent of brightness a pixel keeps per frame once off
+    int scanlines;      // percent the scanline rows are dimmed by
+}video_filter_t;
+
+// screen -> one 128x64 streaming texture, scaled by the renderer in one copy,
+// or with filter.soft one streaming texture at the whole factor that fits the
+// output, filled by chip8_scale and copied 1:1. either is centered whole-factor
+typedef struct {
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    chip8_screen_t screen;                                     // last uploaded screen
+    uint32_t pixels[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT];   // same, expanded
+    bool fading;        // phosphor still settling, render again even without a new frame
+    int factor;         // soft: texture scale, 0 = no texture yet
+    chip8_scale_t *scale;   // soft only
+}video_t;
+
+
+bool video_init(video_t *video, SDL_Renderer *renderer, const video_filter_t *filter);
+
+// upload the rows that differ from the last frame and present,
+// nothing at all if no row changed unless redraw is set
+void video_render(video_t *video, const chip8_screen_t *screen, bool redraw);
+void video_destroy(video_t *video);
+
+#endif // CHIP8_VIDEO_H